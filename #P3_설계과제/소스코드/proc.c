@@ -68,7 +68,146 @@ Priority RunQueue[MAX_IDX]; //RunQueue
 // NEWS=true  -> 4Queues in 1 RunQueue
 /*******************************/
 
-#ifndef NEWS
+#ifdef BITMAP
+// BITMAP (ORIGIN/NEWS/JHS 어느 쪽과도 같이 켤 수 있음)
+// 우선순위 0~99 마다 cpu_used 기준 min-heap 을 하나씩 두고, 비어있지 않은 우선순위는 100비트 비트맵으로 표시
+// -> 가장 작은 우선순위는 비트맵에서 처음 켜진 비트 (O(1)), 그 중 cpu_used 가 가장 적은 프로세스는 heap 의 맨 위 (O(log n))
+// RUNNABLE 인 프로세스만 들어있음 (EMBRYO 는 fork 에서 RUNNABLE 로 바꿀 때 넣음)
+#define MAX_PRI     100
+#define PRI_WORDS   ((MAX_PRI + 31) / 32)
+
+uint priBitmap[PRI_WORDS];          //i 번째 비트 : priHeap[i] 가 비어있지 않음
+struct proc* priHeap[MAX_PRI][NPROC];
+int priCnt[MAX_PRI];
+int priSys[MAX_PRI];                //priHeap[i] 안의 1,2번 프로세스 수 (getSmallestPri 에서 제외)
+uint priSeq;                        //들어온 순서 (우선순위, cpu_used 가 같으면 먼저 들어온 프로세스)
+
+//a 가 b 보다 먼저 뽑혀야 하면 true (1,2번 프로세스는 원래처럼 cpu_used 를 따지지 않고 뽑힘)
+static int priLess(struct proc* a, struct proc* b)
+{
+    uint ua = (a->pid == 1 || a->pid == 2) ? 0 : a->cpu_used;
+    uint ub = (b->pid == 1 || b->pid == 2) ? 0 : b->cpu_used;
+    if (ua != ub)
+        return ua < ub;
+    return a->rq_seq < b->rq_seq;
+}
+
+static void priSwap(int pri, int i, int j)
+{
+    struct proc* tmp = priHeap[pri][i];
+    priHeap[pri][i] = priHeap[pri][j];
+    priHeap[pri][j] = tmp;
+    priHeap[pri][i]->rq_idx = i;
+    priHeap[pri][j]->rq_idx = j;
+}
+
+static void priUp(int pri, int i)
+{
+    while (i > 0 && priLess(priHeap[pri][i], priHeap[pri][(i-1)/2])) {
+        priSwap(pri, i, (i-1)/2);
+        i = (i-1)/2;
+    }
+}
+
+static void priDown(int pri, int i)
+{
+    int min, l, r;
+    for (;;) {
+        min = i, l = i*2+1, r = i*2+2;
+        if (l < priCnt[pri] && priLess(priHeap[pri][l], priHeap[pri][min]))
+            min = l;
+        if (r < priCnt[pri] && priLess(priHeap[pri][r], priHeap[pri][min]))
+            min = r;
+        if (min == i)
+            return;
+        priSwap(pri, i, min);
+        i = min;
+    }
+}
+
+//from 이상의 우선순위 중 비어있지 않은 가장 작은 우선순위 (비트맵에서 처음 켜진 비트), 없으면 -1
+static int priFirst(int from)
+{
+    int w = from / 32;
+    uint bits;
+
+    if (from >= MAX_PRI)
+        return -1;
+    bits = priBitmap[w] & (~0u << (from % 32));
+    for (;;) {
+        if (bits)
+            return w * 32 + __builtin_ctz(bits);
+        if (++w >= PRI_WORDS)
+            return -1;
+        bits = priBitmap[w];
+    }
+}
+
+/**
+ * process 를 우선순위에 해당하는 heap 에 삽입 (이미 들어있으면 무시)
+*/
+void appendProc(struct proc* process)
+{
+    int pri;
+
+    if (process == NULL || process->rq_idx >= 0)
+        return;
+    pri = process->priority < 0 ? 0 : (process->priority >= MAX_PRI ? MAX_PRI - 1 : process->priority);
+    process->rq_pri = pri;
+    process->rq_seq = priSeq++;
+    process->rq_idx = priCnt[pri]++;
+    priHeap[pri][process->rq_idx] = process;
+    priUp(pri, process->rq_idx);
+    if (process->pid == 1 || process->pid == 2)
+        priSys[pri]++;
+    priBitmap[pri / 32] |= 1u << (pri % 32);
+}
+
+/**
+ * process 를 heap 에서 삭제 (O(log n)), 들어있지 않으면 NULL
+*/
+struct proc* deleteProc(struct proc* process)
+{
+    int pri = process->rq_pri, i = process->rq_idx;
+
+    if (i < 0)
+        return NULL;
+    priSwap(pri, i, --priCnt[pri]);
+    process->rq_idx = -1;
+    if (i < priCnt[pri]) {
+        priUp(pri, i);
+        priDown(pri, i);
+    }
+    if (process->pid == 1 || process->pid == 2)
+        priSys[pri]--;
+    if (!priCnt[pri])
+        priBitmap[pri / 32] &= ~(1u << (pri % 32));
+    return process;
+}
+
+//가장 작은 우선순위 중 cpu_used 가 가장 적은 프로세스를 뽑아서 삭제
+struct proc* getHighPri()
+{
+    int pri = priFirst(0);
+
+    if (pri < 0)
+        return NULL;
+    return deleteProc(priHeap[pri][0]);
+}
+
+/**
+ * 가장 작은 우선순위를 찾아내는 함수 없을 시 0 리턴 (1,2번 프로세스만 있는 우선순위는 건너뜀)
+*/
+int getSmallestPri()
+{
+    int pri;
+
+    for (pri = priFirst(0); pri >= 0; pri = priFirst(pri + 1))
+        if (priCnt[pri] > priSys[pri])
+            return pri;
+    return 0;
+}
+#elif !defined(NEWS)
 struct proc* deleteQueue(Priority* queue, struct proc* ptr)
 {
   if (ptr == queue->head && ptr == queue->tail)
@@ -193,69 +332,6 @@ void appendProc(struct proc* process)
 }
 
 
-void updateQueue()
-{
-  //ptable.proc[0].priority = ptable.proc[1].priority = 99;
-  //ptable.proc[0].proc_tick = ptable.proc[1].proc_tick = 0;
-    int i;
-    struct proc *p, *ptr = NULL, *tail = NULL;
-    Priority* queue;
-
-    //RunQueue 순회
-    for (i = 0 ; i < MAX_IDX ; i++) { 
-        queue = &RunQueue[i];
-        //우선순위 갱신이 필요하면 Queue에서 빼서 queue 리스트로 연결
-        for (p = queue->head ; p != NULL ;) {
-            ptr = p;
-            p = ptr->next; //다음 노드로 이동
-            if (ptr->pid == 1 || ptr->pid == 2) { //하필이면 뽑힌 프로세스가 pid: 1,2면 패스
-              ptr->priority_tick = 0;
-              continue;
-            }
-            //검사해보니까 priority_tick도 사용해있거나 우선순위가 맞지않으면 재갱신 시도
-            if (ptr->priority_tick != 0 || ptr->priority/4 != i) {
-                deleteQueue(queue, ptr);
-                //우선순위 재갱신
-
-                //우선순위 갱신은 바로바로 한는게 아니라 한꺼번에 간이 리스트로 연결해뒀다가 한 번에 연결
-                ptr->prev = ptr->next = NULL;
-                if (tail == NULL) {
-                  tail = ptr;
-                }
-                else {
-                  ptr->prev = tail;
-                  tail = ptr;
-                }
-            }
-        }        
-    }
-
-    //tail에 연결된 연결리스트 순회하며 출력
-    while (tail != NULL)
-    {
-
-#if JHS
-      struct proc* tmp = tail;
-      for (; tmp != NULL ; tmp = tmp->prev)  {
-        cprintf("%d(%d)->", tmp->pid, tmp->priority_tick);
-      }
-      cprintf("\n");
-#endif
-  
-      //tail 위치를 다음꺼로 연결하기 위해 tail을 미리작업
-      ptr = tail;
-      tail = tail->prev;
-      ptr->prev = ptr->next = NULL;
-
-      //우선순위 priority += priority_ticks / 10 으로 재갱신
-      ptr->priority = ptr->priority + ptr->priority_tick / 10;
-      ptr->priority = ptr->priority > 99 ? 99 : ptr->priority;
-      ptr->priority_tick = 0;
-      // 재삽입
-      appendProc(ptr);
-    }
-}
-
 /**
  * 가장 작은 우선순위를 찾아내는 함수 없을 시 0 리턴
 */
@@ -446,20 +522,184 @@ void initQueue()
         }
     }
 }
+#endif
+
+// 재갱신 (updateQueue) 대상 : 지난 재갱신 이후 CPU 를 쓴 프로세스만 dirty 리스트에 모아둠 (trap.c 타이머에서 markDirty)
+// 예전처럼 RunQueue 전체를 훑지 않고 dirty 프로세스가 들어있는 큐만 예전 순서 그대로 훑음
+struct proc* dirtyHead;
+
+//dirty 리스트에서 p 를 뺌 (ptable.lock 필요)
+static void cleanDirty(struct proc* p)
+{
+  if (!p->dirty)
+    return;
+  if (p->dirty_prev)
+    p->dirty_prev->dirty_next = p->dirty_next;
+  else
+    dirtyHead = p->dirty_next;
+  if (p->dirty_next)
+    p->dirty_next->dirty_prev = p->dirty_prev;
+  p->dirty_next = p->dirty_prev = NULL;
+  p->dirty = 0;
+}
+
+//타이머에서 이번 재갱신 주기에 처음 CPU 를 쓴 프로세스를 dirty 리스트에 넣음
+void markDirty(struct proc* p)
+{
+  acquire(&ptable.lock);
+  if (!p->dirty) {
+    p->dirty = 1;
+    p->dirty_prev = NULL;
+    p->dirty_next = dirtyHead;
+    if (dirtyHead)
+      dirtyHead->dirty_prev = p;
+    dirtyHead = p;
+  }
+  release(&ptable.lock);
+}
 
 /**
  * Priority 재갱신이 필요할 때 호출하는 함수
  * 스케쥴러 내부에서 호출될 예정
+ * 먼저 dirty 리스트로 RUNNABLE dirty 프로세스가 들어있는 큐를 고르고, 고른 큐만 예전 전체 순회와 같은 순서
+ * (큐 번호 오름차순, 큐 안에서는 앞에서부터) 로 훑으며 같은 조건 (priority_tick 이 있거나 priority/4 가 큐와 다름) 으로
+ * 빼서 priority += priority_tick / 10 (최대 99) 으로 예전과 같은 순서로 다시 넣음 -> 재삽입 순서와 tie-break 가 예전과 같음
+ * priority_tick 이 남은 RunQueue 의 프로세스는 모두 dirty 리스트에 있으므로 고르지 않은 큐에는 갱신할 프로세스가 없음
+ * (priority 는 RunQueue 밖에 있을 때만 바뀌므로 (wakeup1, kill, set_sche_info) priority/4 가 큐와 다른 프로세스도 없음)
+ * 실행 중이거나 잠든 프로세스는 원래처럼 RunQueue 에 들어와 있는 재갱신 때까지 dirty 로 남아 priority_tick 을 모아둠
 */
 void updateQueue()
 {
+  struct proc *p, *next;
+#ifdef BITMAP
+  char touched[MAX_PRI];
+#else
+  char touched[MAX_IDX];
+#endif
+
+  memset(touched, 0, sizeof(touched));
+  for (p = dirtyHead ; p != NULL ; p = next) {
+    next = p->dirty_next;
+    if (p->state != RUNNABLE)
+      continue;
+    cleanDirty(p);
+#ifdef BITMAP
+    touched[p->rq_pri] = 1;
+#else
+    touched[p->priority/4] = 1;
+#endif
+  }
+
+#ifdef BITMAP
+  {
+    int pri, i;
+    struct proc *list = NULL;
+
+    //우선순위 갱신이 필요한 프로세스를 간이 리스트로 연결해뒀다가 (heap 을 도는 중에 빼면 순서가 바뀌므로) 한 번에 재삽입
+    for (pri = priFirst(0); pri >= 0; pri = priFirst(pri + 1)) {
+        if (!touched[pri])
+            continue;
+        for (i = 0; i < priCnt[pri]; i++) {
+            p = priHeap[pri][i];
+            if (p->pid == 1 || p->pid == 2) { //pid: 1,2면 패스
+                p->priority_tick = 0;
+                continue;
+            }
+            if (p->priority_tick != 0) {
+                p->next = list;
+                list = p;
+            }
+        }
+    }
+
+    while (list != NULL)
+    {
+#if JHS
+      struct proc* tmp = list;
+      for (; tmp != NULL ; tmp = tmp->next)  {
+        cprintf("%d(%d)->", tmp->pid, tmp->priority_tick);
+      }
+      cprintf("\n");
+#endif
+      p = list;
+      list = list->next;
+      p->next = NULL;
+      deleteProc(p);
+
+      //우선순위 priority += priority_ticks / 10 으로 재갱신
+      p->priority = p->priority + p->priority_tick / 10;
+      p->priority = p->priority > 99 ? 99 : p->priority;
+      p->priority_tick = 0;
+      appendProc(p);
+    }
+  }
+#elif !defined(NEWS)
+  {
+    int i;
+    struct proc *ptr = NULL, *tail = NULL;
+    Priority* queue;
+
+    //RunQueue 순회 (dirty 프로세스가 있는 Queue 만)
+    for (i = 0 ; i < MAX_IDX ; i++) { 
+        if (!touched[i])
+            continue;
+        queue = &RunQueue[i];
+        //우선순위 갱신이 필요하면 Queue에서 빼서 queue 리스트로 연결
+        for (p = queue->head ; p != NULL ;) {
+            ptr = p;
+            p = ptr->next; //다음 노드로 이동
+            if (ptr->pid == 1 || ptr->pid == 2) { //하필이면 뽑힌 프로세스가 pid: 1,2면 패스
+              ptr->priority_tick = 0;
+              continue;
+            }
+            //검사해보니까 priority_tick도 사용해있거나 우선순위가 맞지않으면 재갱신 시도
+            if (ptr->priority_tick != 0 || ptr->priority/4 != i) {
+                deleteQueue(queue, ptr);
+                //우선순위 갱신은 바로바로 한는게 아니라 한꺼번에 간이 리스트로 연결해뒀다가 한 번에 연결
+                ptr->prev = ptr->next = NULL;
+                if (tail == NULL) {
+                  tail = ptr;
+                }
+                else {
+                  ptr->prev = tail;
+                  tail = ptr;
+                }
+            }
+        }        
+    }
+
+    //tail에 연결된 연결리스트 순회하며 재삽입
+    while (tail != NULL)
+    {
+#if JHS
+      struct proc* tmp = tail;
+      for (; tmp != NULL ; tmp = tmp->prev)  {
+        cprintf("%d(%d)->", tmp->pid, tmp->priority_tick);
+      }
+      cprintf("\n");
+#endif
+      //tail 위치를 다음꺼로 연결하기 위해 tail을 미리작업
+      ptr = tail;
+      tail = tail->prev;
+      ptr->prev = ptr->next = NULL;
+
+      //우선순위 priority += priority_ticks / 10 으로 재갱신
+      ptr->priority = ptr->priority + ptr->priority_tick / 10;
+      ptr->priority = ptr->priority > 99 ? 99 : ptr->priority;
+      ptr->priority_tick = 0;
+      // 재삽입
+      appendProc(ptr);
+    }
+  }
+#else
+  {
     int i, j;
     procQ* queue;
     struct proc* tmp, *updateNode;
-    //RunQueue Index를 차례차례 순회
+    //RunQueue Index를 차례차례 순회 (dirty 프로세스가 있는 Index 만)
     for (i = 0 ; i < MAX_IDX ; i++) {
       //RunQueue내부의 4개의 큐가 모두 비어있음을 확인하는 middleCnt 확인
-        if (!RunQueue[i].middleCnt)
+        if (!touched[i] || !RunQueue[i].middleCnt)
             continue;
         //RunQueue 내부 Queue하나하나에 접근
         for (j = 0 ; j < SUB_IDX ; j++)  { 
@@ -491,8 +731,9 @@ void updateQueue()
             }
         }
     }
-}
+  }
 #endif
+}
 
 /********************************************************************/
 
@@ -605,6 +846,8 @@ found:
 #endif
   //P3 과제를 위한 프로세스 설정
   p->proc_tick = 0; //생성된 시점에서 proc_tick=0으로 설정
+  p->dirty = 0;
+  p->dirty_next = p->dirty_prev = NULL;
   p->priority_tick = p->cpu_used = 0;
   p->proc_deadline = -1;
   p->priority = getSmallestPri();
@@ -615,7 +858,11 @@ found:
   else if (p->priority == 99) //만약 99로 설정된다면 0으로 설정
     p->priority = 0;
   */
+#ifdef BITMAP
+  p->rq_idx = -1; //RUNNABLE 이 될 때 (userinit, fork) 삽입
+#else
   appendProc(p);
+#endif
   return p;
 }
 
@@ -725,6 +972,9 @@ fork(void)
   acquire(&ptable.lock);
 
   //appendProc(np);
+#ifdef BITMAP
+  appendProc(np);
+#endif
   np->state = RUNNABLE;
 
   release(&ptable.lock);
@@ -771,6 +1021,8 @@ exit(void)
     }
   }
 
+  cleanDirty(curproc); //다시 실행되지 않으므로 재갱신 대상에서 뺌
+
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
   sched();
@@ -881,7 +1133,9 @@ scheduler(void)
       updateQueue(); //재갱신 진행시켜
 
       //Queue에서 삽입해야함 (바로 다시 스케쥴리을 할 것이기 때문)
-#ifndef NEWS
+#ifdef BITMAP
+      deleteProc(p);
+#elif !defined(NEWS)
     //RunQueue 용 Switch인 경우엔 재삽입을 위한 프로세스 삭제 (갱신된 후 다시 빼는 과정)
       deleteQueue(&RunQueue[p->priority/4], p);  
 #else
@@ -13,6 +13,7 @@ struct cpu {
 
 extern struct cpu cpus[NCPU];
 extern int ncpu;
+void markDirty(struct proc*);   // proc.c : 타이머에서 재갱신 대상 등록
 
 //PAGEBREAK: 17
 // Saved registers for kernel context switches.
@@ -59,6 +60,12 @@ struct proc {
   uint proc_deadline;     //프로세스 데드라인
   struct proc* next;
   struct proc* prev;
+  int rq_pri;             //BITMAP : 들어있는 우선순위 heap
+  int rq_idx;             //BITMAP : heap 안의 위치, 없으면 -1
+  uint rq_seq;            //BITMAP : 들어온 순서
+  int dirty;              //지난 재갱신 이후 CPU 를 써서 dirty 리스트에 있음
+  struct proc* dirty_next;
+  struct proc* dirty_prev;
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -117,6 +117,8 @@ trap(struct trapframe *tf)
     }
     myproc()->cpu_used++;
     myproc()->priority_tick++;
+    if (!myproc()->dirty) //이번 재갱신 주기에 처음 CPU 를 씀 -> 재갱신 대상으로 등록
+      markDirty(myproc());
     myproc()->proc_tick++;
     //process pid 가 3이상일 때 스케쥴링 시간을 측정함
     if (myproc()->pid != 1 && myproc()->pid != 2 && proc_tick_lock)
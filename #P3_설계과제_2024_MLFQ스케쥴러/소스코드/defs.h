@@ -193,7 +193,7 @@ void            clearpteu(pde_t *pgdir, char *uva);
 // updater
 void scheduler_update(struct proc* p);
 void aging();
-void printNode();
+void balance_mlfq();
 
 //trap
 int level_limit(int lvl);
@@ -6,13 +6,14 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
-#include "queue.h"
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
 } ptable;
 
+#include "queue.h"  //CPU 별 MLFQ 와 lock 순서 (ptable.lock -> runq[].lock) 는 queue.h 참고
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -25,6 +26,7 @@ void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  init_mlfq(); //다른 CPU 의 scheduler 가 돌기 전에 runq[].lock 초기화
 }
 
 // Must be called with interrupts disabled
@@ -124,8 +126,11 @@ found:
   p->io_wait_time = 0;
   p->end_time = 0;
   p->set_time = -1; //default Set Time
+  p->q_prev = p->q_next = NULL;
+  p->q_on = -1; //RUNNABLE 이 될 때 (userinit, fork) 큐에 들어감
+  p->q_cpu = 0;
+  p->heap_idx = -1;
 
-  append_mlfq(p, p->q_level);
   return p;
 }
 
@@ -134,7 +139,6 @@ found:
 void
 userinit(void)
 {
-  init_mlfq();
   struct proc *p;
   extern char _binary_initcode_start[], _binary_initcode_size[];
 
@@ -162,9 +166,13 @@ userinit(void)
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
+  acquire(&runq[p->q_cpu].lock);
 
   p->state = RUNNABLE;
+  wait_start(p);
+  append_mlfq(p, p->q_level);
 
+  release(&runq[p->q_cpu].lock);
   release(&ptable.lock);
 }
 
@@ -227,10 +235,16 @@ fork(void)
 
   pid = np->pid;
 
+  np->q_cpu = idle_mlfq(); //새 프로세스는 가장 한가한 CPU 로
+
   acquire(&ptable.lock);
+  acquire(&runq[np->q_cpu].lock);
 
   np->state = RUNNABLE;
+  wait_start(np);
+  append_mlfq(np, np->q_level);
 
+  release(&runq[np->q_cpu].lock);
   release(&ptable.lock);
 
   return pid;
@@ -277,7 +291,10 @@ exit(void)
   }
 
   // Jump into the scheduler, never to return.
+  // swtch 는 runq lock 만 잡고 함 -> wait 는 그 lock 을 거쳐야 kstack 을 해제함
+  acquire(&runq[curproc->q_cpu].lock);
   curproc->state = ZOMBIE;
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -300,6 +317,10 @@ wait(void)
         continue;
       havekids = 1;
       if(p->state == ZOMBIE){
+        // exit 한 CPU 가 아직 p 의 kstack 에서 swtch 하는 중일 수 있음
+        // scheduler 는 swtch 가 끝난 뒤에 runq lock 을 놓으므로 한 번 잡았다 놓으면 다 끝난 것
+        acquire(&runq[p->q_cpu].lock);
+        release(&runq[p->q_cpu].lock);
         pid = p->pid;
         // Found one.
         kfree(p->kstack);
@@ -340,30 +361,18 @@ scheduler(void)
     // Enable interrupts on this processor.
 
     sti();
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    
-    int breakFlag = false;
-    for (int i = 0 ; i < MLFQ_CNT && !breakFlag ; i++) {
-      node* n = take_mlfq(i);
-      if (n) {
-        p = n->p;
-        breakFlag = true;
-        break;
-      }
-    }
-
-    if (!p || p->state != RUNNABLE) {
-      release(&ptable.lock);
+    //어느 CPU 큐에도 없으면 lock 을 잡지 않고 다시 확인
+    if (!pending_mlfq())
       continue;
-    }
-
-    if (p->pid != 1 && p->pid != 2) 
-      pop_mlfq_pid(p->pid);
 
+    //큐에는 RUNNABLE 만 있으므로 가장 높은 레벨의 프로세스를 바로 꺼냄 (다른 CPU 큐가 더 높으면 그쪽에서)
+    //ptable.lock 은 잡지 않고 이 CPU 의 runq lock 을 잡은 채로 돌아옴
+    p = pick_mlfq(c - cpus);
+    if (!p)
+      continue;
 
     // Switch to chosen process.  It is the process's job
-    // to release ptable.lock and then reacquire it
+    // to release runq[c].lock and then reacquire it
     // before jumping back to us.
     c->proc = p;
     switchuvm(p);
@@ -375,7 +384,7 @@ scheduler(void)
     // Process is done running for now.
     // It should have changed its p->state before coming back.
     c->proc = 0;
-    release(&ptable.lock);
+    release(&runq[c - cpus].lock);
 
   }
 }
@@ -425,8 +434,8 @@ scheduler(void)
 }
 #endif
 
-// Enter scheduler.  Must hold only ptable.lock
-// and have changed proc->state. Saves and restores
+// Enter scheduler.  Must hold only runq[p->q_cpu].lock
+// (this CPU's run queue, see queue.h) and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
 // be proc->intena and proc->ncli, but that would
@@ -438,8 +447,8 @@ sched(void)
   int intena;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&runq[p->q_cpu].lock))
+    panic("sched runq.lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
@@ -455,16 +464,19 @@ sched(void)
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  struct proc *p = myproc();
+
+  //RUNNABLE <-> RUNNING 은 이 CPU 의 runq lock 만 잡음 (ptable.lock 은 필요 없음)
+  acquire(&runq[p->q_cpu].lock);  //DOC: yieldlock
+  p->state = RUNNABLE;
+  wait_start(p);
 
 
   //여기에서 Queue Level 재산정 및 업데이트
-  if (myproc()->pid != 1 && myproc()->pid != 2)
-    append_mlfq(myproc(), myproc()->q_level);
+  append_mlfq(p, p->q_level);
   
   sched();
-  release(&ptable.lock);
+  release(&runq[p->q_cpu].lock); //다른 CPU 가 골랐으면 q_cpu 는 그 CPU
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -473,8 +485,8 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding runq lock from scheduler.
+  release(&runq[myproc()->q_cpu].lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -502,7 +514,7 @@ sleep(void *chan, struct spinlock *lk)
     panic("sleep without lk");
 
   // Must acquire ptable.lock in order to
-  // change p->state and then call sched.
+  // change p->state to SLEEPING.
   // Once we hold ptable.lock, we can be
   // guaranteed that we won't miss any wakeup
   // (wakeup runs with ptable.lock locked),
@@ -512,21 +524,21 @@ sleep(void *chan, struct spinlock *lk)
     release(lk);
   }
   // Go to sleep.
+  // sched 는 이 CPU 의 runq lock 만 잡고 함 -> SLEEPING 으로 바꾼 뒤 ptable.lock 은 놓음
+  // 그 사이 wakeup 이 와도 runq lock 에서 기다리므로 swtch 가 끝나기 전에 큐에 들어가지 않음
+  acquire(&runq[p->q_cpu].lock);
   p->chan = chan;
   p->state = SLEEPING;
+  wait_start(p);
+  release(&ptable.lock);
 
-  if (p->pid != 1 && p->pid != 2)
-    append_mlfq(p, p->q_level);
   sched();
 
-  // Tidy up.
-  p->chan = 0;
+  // Tidy up. (p->chan 은 깨운 쪽이 ptable.lock 을 잡고 지움)
+  release(&runq[p->q_cpu].lock);
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  acquire(lk);  //DOC: sleeplock2
 }
 
 //PAGEBREAK!
@@ -539,7 +551,14 @@ wakeup1(void *chan)
 
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
     if(p->state == SLEEPING && p->chan == chan) {
+      //마지막으로 실행된 CPU 의 큐로 (잠든 CPU 가 아직 swtch 중이면 그 lock 에서 기다림)
+      acquire(&runq[p->q_cpu].lock);
+      wait_stop(p);
       p->state = RUNNABLE;
+      p->chan = 0;
+      wait_start(p);
+      append_mlfq(p, p->q_level);
+      release(&runq[p->q_cpu].lock);
     }
 }
 
@@ -566,8 +585,15 @@ kill(int pid)
       p->killed = 1;
 
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
+      if(p->state == SLEEPING){
+        acquire(&runq[p->q_cpu].lock);
+        wait_stop(p);
         p->state = RUNNABLE;
+        p->chan = 0;
+        wait_start(p);
+        append_mlfq(p, p->q_level);
+        release(&runq[p->q_cpu].lock);
+      }
       release(&ptable.lock);
       return 0;
     }
@@ -596,7 +622,6 @@ procdump(void)
   char *state;
   uint pc[10];
 
-  printNode();
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->state == UNUSED)
       continue;
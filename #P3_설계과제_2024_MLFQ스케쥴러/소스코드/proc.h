@@ -60,6 +60,18 @@ struct proc {
   int io_wait_time;   // sleeping wait time
   int end_time;       // total CPU TIME;
   int set_time;
+
+  // MLFQ 큐 연결 (queue.h), RUNNABLE 일 때만 큐에 들어있음
+  struct proc *q_prev;
+  struct proc *q_next;
+  int q_on;           // 들어있는 큐 레벨, 큐에 없으면 -1
+  int q_cpu;          // 들어갈 (마지막으로 실행된) CPU 의 큐 번호 (runq[])
+
+  // aging (queue.h)
+  int wait_since;     // RUNNABLE/SLEEPING 이 된 tick
+  int wait_deadline;  // 이 tick 이 되면 에이징
+  int heap_lvl;       // 들어있는 aging heap 레벨
+  int heap_idx;       // aging heap 안의 위치, 없으면 -1
 };
 
 // Process memory is laid out contiguously, low addresses first:
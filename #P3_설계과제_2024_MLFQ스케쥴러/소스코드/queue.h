@@ -28,38 +28,59 @@ struct {
 #define NPROC 64
 #endif
 
+#ifndef NCPU
+#define NCPU 8
+#endif
+
 #define MAX_AGING 250
 
 #define MLFQ_CNT 4
-typedef struct node {
-  struct proc* p;
-  struct node* prev;
-  struct node* next;
-  int use_flag;
-}node;
 
+//큐 노드는 struct proc 안의 q_prev/q_next (별도 nodes[] 배열 없음)
+//RUNNABLE 인 프로세스만 큐에 들어있음 -> 고를 때 상태를 확인하며 건너뛸 필요 없음
 typedef struct queue {
-  node* head;
-  node* tail;
+  struct proc* head;
+  struct proc* tail;
   int cnt;
 }queue;
 
-queue mlfq[MLFQ_CNT];
-node nodes[NPROC];
-node dummyNode[MLFQ_CNT*2]; //dummy node;
+//CPU 마다 따로 있는 MLFQ (runq[i] 는 cpus[i] 의 것), 각자 lock 을 가짐
+//프로세스는 p->q_cpu 의 큐와 aging heap 에 들어감 (RUNNABLE, SLEEPING 모두 q_cpu 는 마지막으로 실행된 CPU)
+//
+//lock :
+//  ptable.lock   : 프로세스 할당/해제, SLEEPING/ZOMBIE 로 바뀌거나 벗어날 때, chan/parent/killed
+//  runq[c].lock  : runq[c] 의 큐, 비트맵, aging heap, q_cpu 가 c 인 프로세스의 RUNNABLE <-> RUNNING 과 q_level
+//                  예전의 ptable.lock 처럼 swtch 하는 동안 잡고 있음 (scheduler 가 잡고 프로세스가 놓음)
+//                  -> 고르기/yield 는 자기 CPU 의 lock 만 잡으므로 CPU 끼리 겹치지 않음
+//  순서 : ptable.lock -> runq[i].lock -> runq[j].lock (i < j)
+typedef struct runqueue {
+  struct spinlock lock;
+  queue mlfq[MLFQ_CNT];
+  uint bitmap;      // i 번째 비트 : mlfq[i] 가 비어있지 않음 -> 가장 높은 레벨을 O(1) 로 찾음
+  int cnt;          // 모든 레벨의 프로세스 수
+
+  //aging : 레벨마다 RUNNABLE/SLEEPING 프로세스를 올라갈 tick (wait_deadline) 기준 min-heap 으로 둠
+  //매 tick 마다 모든 프로세스의 대기 시간을 1 씩 올리지 않고, 상태가 바뀔 때 (wait_start/wait_stop) 한꺼번에 더함
+  struct proc* aheap[MLFQ_CNT][NPROC];
+  int aheap_cnt[MLFQ_CNT];
+}runqueue;
 
+runqueue runq[NCPU];
+
+#define BALANCE_TICKS 10
 
-node* newNode(struct proc* p);
-void dieNode(node* node);
-void dieNodePid(int pid);
 
 void init_mlfq() ;
 void append_mlfq(struct proc* p, int level);
-void pop_mlfq(int level, int pid);
-node* take_mlfq(int level);
+int pop_mlfq(struct proc* p);
+struct proc* pick_mlfq(int cpu);
+int idle_mlfq();
+int pending_mlfq();
+void balance_mlfq();
+void wait_start(struct proc* p);
+void wait_stop(struct proc* p);
 
 int reLevel(struct proc* p) ;
-void printNode();
 
 
 //Implementation
@@ -117,220 +138,305 @@ int reLevel(struct proc* p) {
 }
 
 
-node* newNode(struct proc* p) {
-  node* next = NULL;
-  int i = p->pid % NPROC, cnt = 0;
-  for (; cnt < NPROC ; i = (i+1)%NPROC, cnt++) {
-    if (nodes[i].use_flag) continue;
-    next = &nodes[i];
-    break;
+void init_mlfq() {
+  for (int c = 0 ; c < NCPU ; c++) {
+    initlock(&runq[c].lock, "runq");
+    for (int i = 0 ; i < MLFQ_CNT ; i++) {
+      runq[c].mlfq[i].cnt = 0;
+      runq[c].mlfq[i].head = runq[c].mlfq[i].tail = NULL;
+      runq[c].aheap_cnt[i] = 0;
+    }
+    runq[c].bitmap = 0;
+    runq[c].cnt = 0;
   }
-
-  if (!next) return NULL;
-
-  next->p = p;
-  next->prev = NULL;
-  next->next = NULL;
-  next->use_flag = true;
-  return next;
 }
 
-void dieNode(node* node) {
-  node->use_flag = false;
-  node->next = node->prev = NULL;
-  node->p = NULL;
+//두 CPU 큐의 lock 을 번호 순서대로 잡음 (a != b)
+void lock2_mlfq(int a, int b) {
+  if (a > b) { int t = a; a = b; b = t; }
+  acquire(&runq[a].lock);
+  acquire(&runq[b].lock);
 }
 
 
-//dummy node 추가
-void init_mlfq() {
-  for (int i = 0 ; i < MLFQ_CNT ; i++) {
-    node* d_head = &dummyNode[i*2];
-    node* d_tail = &dummyNode[i*2+1];
-    
-    d_head->next = d_tail;
-    d_tail->prev = d_head;
-    mlfq[i].cnt = 0;
-    mlfq[i].head = d_head;
-    mlfq[i].tail = d_tail;
+//runq[p->q_cpu].lock 을 잡은 채로 RUNNABLE 이 된 프로세스를 level 큐 뒤에 넣음 (O(1))
+//pid 1, 2 (init, sh) 는 앞에 넣어서 같은 레벨의 다른 프로세스보다 늦게 뽑히도록 함
+void append_mlfq(struct proc* p, int level) {
+  if (p->q_on >= 0) return; //이미 들어있음
+
+  //잘못된 레벨이라고 버리면 RUNNABLE 인데 큐에 없는 프로세스가 되므로 범위 안으로 맞춤
+  if (level < 0) level = 0;
+  if (level >= MLFQ_CNT) level = MLFQ_CNT-1;
+
+  runqueue* rq = &runq[p->q_cpu];
+  queue* q = &rq->mlfq[level];
+
+  if (p->pid == 1 || p->pid == 2) {
+    p->q_prev = NULL;
+    p->q_next = q->head;
+    if (q->head) q->head->q_prev = p;
+    else q->tail = p;
+    q->head = p;
+  }
+  else {
+    p->q_next = NULL;
+    p->q_prev = q->tail;
+    if (q->tail) q->tail->q_next = p;
+    else q->head = p;
+    q->tail = p;
   }
+
+  q->cnt++;
+  rq->cnt++;
+  p->q_on = level;
+  rq->bitmap |= 1 << level;
 }
 
+//p 가 들어있는 큐에서 p 를 뺌 (O(1)), 큐에 없었으면 false
+//runq[p->q_cpu].lock 을 잡고 있어야 함
+int pop_mlfq(struct proc* p) {
+  if (p->q_on < 0) return false;
 
-void append_mlfq(struct proc* p, int level) {
-  if (level < 0 || level > MLFQ_CNT) return; //잘못됨 뭔가
+  runqueue* rq = &runq[p->q_cpu];
+  queue* q = &rq->mlfq[p->q_on];
 
-  queue* q = &mlfq[level];
-  
-  node* me = newNode(p);
+  if (p->q_prev) p->q_prev->q_next = p->q_next;
+  else q->head = p->q_next;
+  if (p->q_next) p->q_next->q_prev = p->q_prev;
+  else q->tail = p->q_prev;
 
-  node* tail = q->tail;
-  node* tail_prev = q->tail->prev;
+  if (--q->cnt == 0)
+    rq->bitmap &= ~(1 << p->q_on);
+  rq->cnt--;
+  p->q_prev = p->q_next = NULL;
+  p->q_on = -1;
+  return true;
+}
 
-  tail->prev = tail_prev->next = me;
-  me->prev = tail_prev;
-  me->next = tail;
+//lock 없이 훔쳐봄 : c 의 비어있지 않은 가장 높은 레벨, 비었으면 MLFQ_CNT
+int toplevel_mlfq(int c) {
+  uint bm = *(volatile uint*)&runq[c].bitmap;
+  return bm ? __builtin_ctz(bm) : MLFQ_CNT;
+}
 
-  q->cnt++;
-  me->use_flag = true;
+//cpu 를 뺀 나머지 중 큐에 가장 많이 들어있는 CPU, 다 비었으면 -1 (lock 없이 훔쳐봄)
+int busiest_mlfq(int cpu) {
+  int best = -1;
+  for (int c = 0 ; c < ncpu ; c++) {
+    if (c != cpu && runq[c].cnt > 0 && (best < 0 || runq[c].cnt > runq[best].cnt))
+      best = c;
+  }
+  return best;
 }
 
-//맨 앞의 process 가져옴 -> pop  with RUNNIG
-node* take_mlfq(int level) {
-  if (!mlfq[level].cnt) return NULL;
+//큐에 가장 적게 들어있는 CPU (fork 한 자식을 넣을 곳, lock 없이 훔쳐봄)
+int idle_mlfq() {
+  int best = 0;
+  for (int c = 1 ; c < ncpu ; c++) {
+    if (runq[c].cnt < runq[best].cnt)
+      best = c;
+  }
+  return best;
+}
 
-  node* candidate = mlfq[level].tail->prev;
+//cpu 가 실행할 프로세스를 골라 큐에서 꺼냄 -> runq[cpu].lock 을 잡은 채로 돌려줌 (없으면 lock 없이 NULL)
+//모든 CPU 큐 중 비어있지 않은 가장 높은 레벨이 있는 곳에서 가져옴 (같으면 내 큐, 다음은 더 바쁜 큐)
+//-> 다른 CPU 큐의 높은 레벨 프로세스가 내 큐의 낮은 레벨 프로세스 때문에 기다리지 않음 (CPU 사이 우선순위 역전 방지)
+//각 레벨 안에서는 맨 뒤 (가장 최근에 들어온) process 를 가져옴, 비트맵으로 O(1)
+struct proc* pick_mlfq(int cpu) {
+  int src = cpu, best = toplevel_mlfq(cpu);
+
+  for (int c = 0 ; c < ncpu ; c++) {
+    int lvl = toplevel_mlfq(c);
+    if (c != cpu && (lvl < best || (lvl == best && src != cpu && runq[c].cnt > runq[src].cnt))) {
+      src = c;
+      best = lvl;
+    }
+  }
+  if (best == MLFQ_CNT) return NULL;
 
+  if (src == cpu)
+    acquire(&runq[cpu].lock);
+  else
+    lock2_mlfq(cpu, src);
 
-  while (candidate != &dummyNode[level*2] && candidate->p->state != RUNNABLE) {
-    candidate = candidate->prev;
+  //lock 을 잡는 사이에 다른 CPU 가 가져갔으면 내 큐에서라도 찾음
+  if (!runq[src].bitmap && src != cpu) {
+    release(&runq[src].lock);
+    src = cpu;
+  }
+  if (!runq[src].bitmap) {
+    release(&runq[cpu].lock);
+    return NULL;
   }
 
-  if (!candidate->p || candidate->p->state != RUNNABLE) return NULL;
-  
-  return candidate;
+  struct proc* p = runq[src].mlfq[__builtin_ctz(runq[src].bitmap)].tail;
+  pop_mlfq(p);
+  wait_stop(p); //기다린 시간은 여기서 한꺼번에 셈 (src 의 heap 에서 빠짐)
+  p->q_cpu = cpu; //이제 이 CPU 의 프로세스
+  if (src != cpu)
+    release(&runq[src].lock);
+  return p;
 }
 
+//lock 없이 훔쳐볼 때 : 어느 CPU 큐에든 프로세스가 있으면 true
+//idle CPU 가 할 일이 없는데도 lock 을 계속 잡았다 놓으며 다른 CPU 와 경쟁하지 않도록 함
+int pending_mlfq() {
+  for (int c = 0 ; c < ncpu ; c++) {
+    if (*(volatile int*)&runq[c].cnt > 0)
+      return true;
+  }
+  return false;
+}
 
-int pop_mlfq_pid(int pid) {
-  node *take = NULL;
-  int breakFlag = false;
-  for (int i = 0; i < MLFQ_CNT && !breakFlag; i++)
-  {
-    if (!mlfq[i].cnt)
-      continue;
-    queue *q = &mlfq[i];
-    take = q->head->next;
-
-    for (; take != q->tail; take = take->next)
-    {
-      if (take->p && take->p->pid == pid) {
-        breakFlag = true;
-        break;
-      }
-    }
+void aheap_swap(runqueue* rq, int lvl, int i, int j) {
+  struct proc* t = rq->aheap[lvl][i];
+  rq->aheap[lvl][i] = rq->aheap[lvl][j];
+  rq->aheap[lvl][j] = t;
+  rq->aheap[lvl][i]->heap_idx = i;
+  rq->aheap[lvl][j]->heap_idx = j;
+}
 
-    if (take == q->tail || !take->p || take->p->pid != pid)
-      continue;
+void aheap_up(runqueue* rq, int lvl, int i) {
+  while (i > 0 && rq->aheap[lvl][(i-1)/2]->wait_deadline > rq->aheap[lvl][i]->wait_deadline) {
+    aheap_swap(rq, lvl, i, (i-1)/2);
+    i = (i-1)/2;
   }
-  if (!take || !(take->p) || take->p->pid != pid) return false;
-  node* next = take->next;
-  node* prev = take->prev;
-  next->prev = prev;
-  prev->next = next;
-  
-  int lvl = take->p->q_level;
-  mlfq[lvl].cnt--; 
-  //cprintf("out pop_mlfq\n");
-  dieNode(take);
-  return true;
 }
 
-void pop_mlfq(int level, int pid) {
-
-  if (!mlfq[level].cnt) {
-    return;
+void aheap_down(runqueue* rq, int lvl, int i) {
+  for (;;) {
+    int min = i, l = i*2+1, r = i*2+2;
+    if (l < rq->aheap_cnt[lvl] && rq->aheap[lvl][l]->wait_deadline < rq->aheap[lvl][min]->wait_deadline) min = l;
+    if (r < rq->aheap_cnt[lvl] && rq->aheap[lvl][r]->wait_deadline < rq->aheap[lvl][min]->wait_deadline) min = r;
+    if (min == i) return;
+    aheap_swap(rq, lvl, i, min);
+    i = min;
   }
+}
 
-  queue* q = &mlfq[level];
+//p 를 runq[p->q_cpu] 의 heap 에 넣음 (wait_deadline 은 정해져 있어야 함, O(log n))
+void aheap_insert(struct proc* p) {
+  runqueue* rq = &runq[p->q_cpu];
+  int lvl = p->q_level;
+
+  if (lvl < 0) lvl = 0;
+  if (lvl >= MLFQ_CNT) lvl = MLFQ_CNT-1;
+  p->heap_lvl = lvl;
+  p->heap_idx = rq->aheap_cnt[lvl]++;
+  rq->aheap[lvl][p->heap_idx] = p;
+  aheap_up(rq, lvl, p->heap_idx);
+}
 
-  node* take = mlfq[level].head->next;
-  for ( ; take != mlfq[level].tail ; take = take->next) {
-    if (take->p && take->p->pid == pid) break;
+//p 를 runq[p->q_cpu] 의 heap 에서 뺌 (O(log n))
+void aheap_remove(struct proc* p) {
+  runqueue* rq = &runq[p->q_cpu];
+  int lvl = p->heap_lvl, i = p->heap_idx;
+
+  aheap_swap(rq, lvl, i, --rq->aheap_cnt[lvl]);
+  p->heap_idx = -1;
+  if (i < rq->aheap_cnt[lvl]) {
+    aheap_up(rq, lvl, i);
+    aheap_down(rq, lvl, i);
   }
+}
 
-  if (take == mlfq[level].tail || !take->p || take->p->pid != pid) return;
+//BALANCE_TICKS 마다 (trap.c 에서 CPU 0 이 매 tick 부름) 가장 바쁜 CPU 의 가장 낮은 레벨에서 하나를 가장 한가한 CPU 로 옮김
+//두 큐의 lock 만 잡음 (aging heap 자리도 같이 옮기고 올라갈 tick 은 그대로)
+void balance_mlfq() {
+  if (ticks % BALANCE_TICKS) return;
+  int to = idle_mlfq();
+  int from = busiest_mlfq(to);
+  if (from < 0) return;
+  lock2_mlfq(from, to);
+  if (runq[from].cnt - runq[to].cnt >= 2) {
+    struct proc* p = runq[from].mlfq[31 - __builtin_clz(runq[from].bitmap)].head;
+    pop_mlfq(p);
+    if (p->heap_idx >= 0)
+      aheap_remove(p);
+    p->q_cpu = to;
+    if (p->pid != 1 && p->pid != 2)
+      aheap_insert(p);
+    append_mlfq(p, p->q_level);
+  }
+  release(&runq[from].lock);
+  release(&runq[to].lock);
+}
 
-  node* next = take->next;
-  node* prev = take->prev;
-  next->prev = prev;
-  prev->next = next;
-  dieNode(take);
-  q->cnt--;
-  //cprintf("out pop_mlfq\n");
+//runq[p->q_cpu].lock 을 잡은 채로 p->state 를 RUNNABLE/SLEEPING 으로 바꾼 직후 부름 : 대기 시작 tick 기록
+//지금 늘어날 쪽 카운터 (RUNNABLE 이면 cpu_wait, SLEEPING 이면 io_wait_time) 가 MAX_AGING 이 되는 tick 을 heap 에 넣음
+//(이미 어느 한 쪽이 MAX_AGING 이상이면 다음 tick) -> 예전처럼 매 tick 1 씩 올리다가 넘는 시점과 같음
+void wait_start(struct proc* p) {
+  p->wait_since = ticks;
+  if (p->pid == 1 || p->pid == 2) return; //init, sh 는 올리지 않으므로 시간만 셈
 
-  return; 
-}
+  int inc = (p->state == RUNNABLE) ? p->cpu_wait : p->io_wait_time;
+  int other = (p->state == RUNNABLE) ? p->io_wait_time : p->cpu_wait;
+  int left = (other >= MAX_AGING || inc >= MAX_AGING) ? 1 : MAX_AGING - inc;
 
-void aging() {
-    for (int i = 0 ; i < MLFQ_CNT ; i++) {
+  p->wait_deadline = ticks + left;
+  aheap_insert(p);
+}
 
-      if (!mlfq[i].cnt) continue;
+//runq[p->q_cpu].lock 을 잡은 채로 p 가 RUNNABLE/SLEEPING 에서 벗어나기 직전에 부름 (scheduler 가 고를 때, 깨어날 때)
+//기다린 시간을 한꺼번에 카운터에 더함
+void wait_stop(struct proc* p) {
+  if (p->state == RUNNABLE)
+    p->cpu_wait += ticks - p->wait_since;
+  else if (p->state == SLEEPING)
+    p->io_wait_time += ticks - p->wait_since;
+  if (p->heap_idx >= 0)
+    aheap_remove(p);
+}
 
-      for (node *ptr = mlfq[i].head->next ; ptr != &dummyNode[i*2+1] ; ) {
-        if (ptr->p->state == RUNNABLE) {
-          ptr->p->cpu_wait++;
-        }
-        else if (ptr->p->state == SLEEPING) {
-          ptr->p->io_wait_time++;
-        }
+//올라갈 tick 이 지난 프로세스만 heap 에서 꺼냄 -> tick 마다 O(올라가는 프로세스 수)
+//올라간 프로세스는 카운터가 0 이 되고 계속 기다리는 중이므로 새 레벨 heap 에 다시 들어감 (같은 tick 에 두 번 오르지 않음)
+//CPU 큐마다 heap 맨 위만 lock 없이 훔쳐보고 올릴 프로세스가 있는 큐의 lock 만 잡음
+void aging() {
+  for (int c = 0 ; c < ncpu ; c++) {
+    runqueue* rq = &runq[c];
+    int due = false;
 
-        if (ptr->p->pid == 1 || ptr->p->pid == 2) {
-          ptr = ptr->next;
-          continue;
-        }
+    for (int i = 0 ; i < MLFQ_CNT ; i++) {
+      if (*(volatile int*)&rq->aheap_cnt[i] > 0 && rq->aheap[i][0]->wait_deadline <= (int)ticks)
+        due = true;
+    }
+    if (!due) continue;
 
-        struct proc* p = ptr->p;
-        ptr = ptr->next;
-        if (p->cpu_wait >= MAX_AGING || p->io_wait_time >= MAX_AGING) {
-          p->io_wait_time = 0;
-          p->cpu_wait = 0;
-          if (i >= 1) {
-
-            // 에이징? 커널 프린트
-            cprintf("PID: %d Aging\n", p->pid);
-            pop_mlfq(i, p->pid);
-            p->q_level--;
-            append_mlfq(p, i-1);
-          }
+    int aged[NPROC], naged = 0;
+    acquire(&rq->lock);
+    for (int i = 0 ; i < MLFQ_CNT ; i++) {
+      while (rq->aheap_cnt[i] > 0 && rq->aheap[i][0]->wait_deadline <= (int)ticks) {
+        struct proc* p = rq->aheap[i][0];
+
+        wait_stop(p);
+        p->io_wait_time = 0;
+        p->cpu_wait = 0;
+        if (p->q_level >= 1) {
+          aged[naged++] = p->pid;
+          p->q_level--;
+          if (pop_mlfq(p)) //SLEEPING 이면 깨어날 때 올라간 레벨에 들어감
+            append_mlfq(p, p->q_level);
         }
+        wait_start(p);
       }
     }
-  
+    release(&rq->lock);
+
+    // 에이징? 커널 프린트
+    // runq lock 을 놓고 찍음 (consoleintr 는 cons.lock 을 잡은 채 wakeup 으로 runq lock 을 잡음)
+    for (int k = 0 ; k < naged ; k++)
+      cprintf("PID: %d Aging\n", aged[k]);
+  }
 }
 
 //Scheduler update 구현
 void scheduler_update(struct proc* p) {
-  int state = false;
-  if (p->pid != 1 && p->pid != 2)
-    state = pop_mlfq_pid(p->pid);
-
-  if (state)
+  acquire(&runq[p->q_cpu].lock);
+  if (pop_mlfq(p))
     append_mlfq(p, p->q_level);
   p->end_time = 0;
+  release(&runq[p->q_cpu].lock);
 }
 
-
-
-  char* cvtState(int v) {
-    switch(v) {
-    case UNUSED:
-      return "Unused";
-    case EMBRYO: 
-      return "Embryo";
-    case SLEEPING:
-      return "sleeping";
-    case RUNNABLE:
-      return "runnable";
-    case RUNNING:
-      return "running";
-    case ZOMBIE:
-      return "Zombie";
-    };
-
-    return "??";
-  }
-  void printNode() {
-    for (int i = 0 ; i < MLFQ_CNT ; i++) {
-      cprintf("<<< %d >>> \n", i);
-
-      if (!mlfq[i].cnt) continue;
-      for (node *ptr = mlfq[i].head->next ; ptr != &dummyNode[i*2+1] ; ptr = ptr->next) {
-        cprintf("%d(%s, flag=%d, i=%p) ", ptr->p->pid, cvtState(ptr->p->state), ptr->use_flag, ptr - nodes);
-      }
-      cprintf("\n");
-    }
-
-    cprintf("===========\n");
-  }
 #endif
\ No newline at end of file
@@ -138,6 +138,10 @@ trap(struct trapframe *tf)
 
       //aging
       aging();
+
+      //CPU 별 큐 사이 개수 맞추기 (BALANCE_TICKS 마다)
+      if (cpuid() == 0)
+        balance_mlfq();
      }
 
   // Check if the process has been killed since we yielded
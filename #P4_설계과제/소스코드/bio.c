@@ -0,0 +1,229 @@
+// Buffer cache.
+//
+// The buffer cache is a linked list of buf structures holding
+// cached copies of disk block contents.  Caching disk blocks
+// in memory reduces the number of disk reads and also provides
+// a synchronization point for disk blocks used by multiple processes.
+//
+// Interface:
+// * To get a buffer for a particular disk block, call bread.
+// * After changing buffer data, call bwrite to write it to disk.
+// * When done with the buffer, call brelse.
+// * Do not use the buffer after calling brelse.
+// * Only one process at a time can use a buffer,
+//     so do not keep them longer than necessary.
+//
+// The implementation uses two state flags internally:
+// * B_VALID: the buffer data has been read from the disk.
+// * B_DIRTY: the buffer data has been modified
+//     and needs to be written to disk.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+// P4 : 동시에 미리 읽는 중(B_ASYNC)일 수 있는 버퍼 수 상한
+// 읽는 중인 버퍼는 재사용할 수 없으므로 나머지 버퍼가 bread/log 에 남도록 제한
+#define RA_INFLIGHT (NBUF/4)
+
+struct {
+  struct spinlock lock;
+  struct buf buf[NBUF];
+
+  // Linked list of all buffers, through prev/next.
+  // head.next is most recently used.
+  struct buf head;
+} bcache;
+
+void
+binit(void)
+{
+  struct buf *b;
+
+  initlock(&bcache.lock, "bcache");
+
+//PAGEBREAK!
+  // Create linked list of buffers
+  bcache.head.prev = &bcache.head;
+  bcache.head.next = &bcache.head;
+  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+    b->next = bcache.head.next;
+    b->prev = &bcache.head;
+    initsleeplock(&b->lock, "buffer");
+    bcache.head.next->prev = b;
+    bcache.head.next = b;
+  }
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+
+again:
+  // Is the block already cached?
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);
+      return b;
+    }
+  }
+
+  // Not cached; recycle an unused buffer.
+  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
+  // because log.c has modified it but not yet committed it.
+  // B_ASYNC : 미리 읽기 중인 버퍼도 디스크가 data 에 쓰고 있으므로 재사용 불가
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0 && (b->flags & (B_DIRTY|B_ASYNC)) == 0) {
+      b->dev = dev;
+      b->blockno = blockno;
+      b->flags = 0;
+      b->refcnt = 1;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);
+      return b;
+    }
+  }
+  // P4 : 미리 읽기 중인 버퍼만 남았으면 그 읽기가 끝나기를 기다렸다가 다시 찾음
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
+      b->refcnt++;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);
+      iderw(b);
+      brelse(b);
+      acquire(&bcache.lock);
+      goto again;
+    }
+  }
+  panic("bget: no buffers");
+}
+
+// Return a locked buf with the contents of the indicated block.
+struct buf*
+bread(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  if((b->flags & B_VALID) == 0) {
+    iderw(b);
+  }
+  return b;
+}
+
+// P4 : 블록 전체를 덮어쓸 때 사용 (writei 의 직접 쓰기 경로)
+// 디스크에서 읽지 않고 잠긴 buf 를 돌려줌. 호출한 쪽이 data 를 모두 채운 뒤 bwrite 해야 함
+struct buf*
+getblk(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  if(b->flags & B_ASYNC)
+    iderw(b);   //미리 읽기가 끝나기를 기다림 (끝난 뒤 덮어써야 함)
+  b->flags |= B_VALID;
+  return b;
+}
+
+// P4 : 미리 읽기 (read-ahead)
+// 캐시에 없으면 빈 버퍼를 잡아 디스크 읽기를 요청만 하고 기다리지 않음
+// 이미 캐시에 있거나(읽는 중 포함) 재사용할 버퍼가 없거나
+// 이미 RA_INFLIGHT 개를 읽는 중이면 아무것도 안 함
+void
+bprefetch(uint dev, uint blockno)
+{
+  struct buf *b;
+  int inflight = 0;
+
+  acquire(&bcache.lock);
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      release(&bcache.lock);
+      return;
+    }
+    if(b->flags & B_ASYNC)
+      inflight++;
+  }
+  if(inflight >= RA_INFLIGHT){
+    release(&bcache.lock);
+    return;
+  }
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0 && (b->flags & (B_DIRTY|B_ASYNC)) == 0) {
+      b->dev = dev;
+      b->blockno = blockno;
+      b->flags = 0;
+      b->refcnt = 1;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);
+      ideread_async(b);
+      brelse(b);
+      return;
+    }
+  }
+  release(&bcache.lock);
+}
+
+// Write b's contents to disk.  Must be locked.
+void
+bwrite(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bwrite");
+  b->flags |= B_DIRTY;
+  iderw(b);
+}
+
+// P4 : 디스크상 연속된 블록의 잠긴 버퍼 bp[0..n) 을 디스크 요청 하나로 씀 (writei 의 직접 쓰기 경로)
+void
+bwritev(struct buf **bp, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bp[i]->lock))
+      panic("bwritev");
+    bp[i]->flags |= B_DIRTY;
+  }
+  idewritev(bp, n);
+}
+
+// Release a locked buffer.
+// Move to the head of the MRU list.
+void
+brelse(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  releasesleep(&b->lock);
+
+  acquire(&bcache.lock);
+  b->refcnt--;
+  if (b->refcnt == 0) {
+    // no one is waiting for it.
+    b->next->prev = b->prev;
+    b->prev->next = b->next;
+    b->next = bcache.head.next;
+    b->prev = &bcache.head;
+    bcache.head.next->prev = b;
+    bcache.head.next = b;
+  }
+  
+  release(&bcache.lock);
+}
+//PAGEBREAK!
+// Blank page.
+
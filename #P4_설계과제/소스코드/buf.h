@@ -0,0 +1,15 @@
+struct buf {
+  int flags;
+  uint dev;
+  uint blockno;
+  struct sleeplock lock;
+  uint refcnt;
+  struct buf *prev; // LRU cache list
+  struct buf *next;
+  struct buf *qnext; // disk queue
+  struct buf *rnext; // P4 : 여러 블록 쓰기 (idewritev) 에서 같은 요청으로 이어서 쓸 다음 블록
+  uchar data[BSIZE];
+};
+#define B_VALID 0x2  // buffer has been read from disk
+#define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_ASYNC 0x8  // P4 : 미리 읽기(read-ahead)로 요청해서 디스크가 읽는 중
@@ -9,12 +9,16 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
+struct buf*     getblk(uint, uint);
+void            bprefetch(uint, uint);
 
 // console.c
 void            consoleinit(void);
@@ -36,13 +40,16 @@ int             filewrite(struct file*, char*, int n);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
+void            dcache_enter(struct inode*, char*, uint, uint);
 int             dirlink(struct inode*, char*, uint);
+void            hdirinit(struct inode*);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
+void            ireap(void);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
@@ -57,6 +64,8 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            ideread_async(struct buf*);
+void            idewritev(struct buf**, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -68,6 +77,11 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kincref(char*);
+int             krefcnt(char*);
+int             kfreecount(void);
+char*           ksuperalloc(void);
+extern char     zeropage[];
 
 // kbd.c
 void            kbdintr(void);
@@ -112,6 +126,7 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+char*           pageout(uint, uint);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
@@ -121,6 +136,16 @@ int             wait(void);
 void            wakeup(void*);
 void            yield(void);
 
+// swap.c
+void            swapinit(int);
+void            swapdup(uint);
+void            swapfree(uint);
+int             swapout(uint);
+char*           swapalloc(uint);
+int             swapin(uint*, uint);
+void            swapwait(void);
+void            swapwake(void);
+
 // swtch.S
 void            swtch(struct context**, struct context*);
 
@@ -161,6 +186,7 @@ void            timerinit(void);
 
 // trap.c
 void            idtinit(void);
+int             pagefault(uint, uint, int);
 extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
@@ -186,6 +212,19 @@ void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 int             mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
+struct vma*     vmalookup(struct proc*, uint);
+int             vmaadd(struct proc*, uint, uint, struct file*, uint, int);
+int             vmaremove(struct proc*, uint, uint);
+uint*           clockscan(pde_t*, uint*, uint, uint, uint, uint);
+int             pinuvm(char*, int, int);
+void            unpinuvm(void);
+int             uvmcheck(uint, uint);
+int             copyoutuser(uint, void*, uint);
+int             lazyuvm(pde_t*, uint, uint);
+int             filluvm(pde_t*, uint, uint, struct inode*, uint, uint);
+int             superuvm(pde_t*, struct vma*, uint);
+void            vmaread(struct vma*, char*, uint);
+void            vmaflush(struct proc*, uint, uint);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -0,0 +1,168 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "defs.h"
+#include "x86.h"
+#include "elf.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+
+#define NSEG 4  // 지연 적재할 수 있는 프로그램 세그먼트 수
+
+int
+exec(char *path, char **argv)
+{
+  char *s, *last;
+  int i, off, nseg, r;
+  uint argc, sz, sp, nlazy, nfill, ustack[3+MAXARG+1];
+  struct elfhdr elf;
+  struct inode *ip;
+  struct proghdr ph, seg[NSEG];
+  struct file *f;
+  pde_t *pgdir, *oldpgdir;
+  struct proc *curproc = myproc();
+
+  begin_op();
+
+  if((ip = namei(path)) == 0){
+    end_op();
+    cprintf("exec: fail\n");
+    return -1;
+  }
+  ilock(ip);
+  pgdir = 0;
+  f = 0;
+
+  // Check ELF header
+  if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
+    goto bad;
+  if(elf.magic != ELF_MAGIC)
+    goto bad;
+
+  if((pgdir = setupkvm()) == 0)
+    goto bad;
+
+  // Load program into memory.
+  // P4 : 세그먼트를 읽지 않고 PTE_LAZY 로 예약만 함 (loaduvm 대신)
+  // 처음 접근할 때 trap.c 가 mmap 구간처럼 파일에서 읽어옴 (filesz 뒤는 bss 라 0)
+  // 쓰기 가능한 세그먼트는 커널이 pipe/console lock 을 잡은 채 처음 건드릴 수 있는 전역 버퍼가 있으므로 filesz 전체를 바로 읽음
+  // (코드와 데이터가 한 세그먼트인 ld -N 실행 파일은 코드까지 바로 읽고, 지연 적재되는 것은 bss 뿐)
+  // 지연 적재 중인 실행 파일은 쓰기를 막아서 (file.h ntext) 나중에 읽는 페이지가 exec 때와 같도록 함
+  sz = 0;
+  nseg = 0;
+  nlazy = 0;
+  nfill = 0;
+  for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
+    if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
+      goto bad;
+    if(ph.type != ELF_PROG_LOAD)
+      continue;
+    if(ph.memsz < ph.filesz)
+      goto bad;
+    if(ph.vaddr + ph.memsz < ph.vaddr)
+      goto bad;
+    if(ph.vaddr % PGSIZE != 0)
+      goto bad;
+    //세그먼트마다 구간 하나 (앞 세그먼트와 페이지를 나눠 쓰면 안 됨)
+    if(nseg == NSEG || ph.vaddr < PGROUNDUP(sz) || ph.vaddr + ph.memsz >= KERNBASE)
+      goto bad;
+    if(lazyuvm(pgdir, ph.vaddr, ph.vaddr + ph.memsz) < 0)
+      goto bad;
+    seg[nseg++] = ph;
+    nlazy += PGROUNDUP(ph.memsz) / PGSIZE;
+    if(ph.flags & ELF_PROG_FLAG_WRITE){
+      if((r = filluvm(pgdir, ph.vaddr, PGROUNDUP(ph.vaddr + ph.filesz), ip,
+                      ph.off, ph.filesz)) < 0)
+        goto bad;
+      nfill += r;
+    }
+    sz = ph.vaddr + ph.memsz;
+  }
+  //구간들이 실행 파일을 계속 참조할 수 있도록 읽기 전용 파일 하나를 만들어 둠
+  if(nseg > 0){
+    if((f = filealloc()) == 0)
+      goto bad;
+    f->type = FD_INODE;
+    f->ip = idup(ip);
+    f->off = 0;
+    f->readable = 1;
+    f->writable = 0;
+    f->text = 1;
+    ip->ntext++;
+  }
+  iunlockput(ip);
+  end_op();
+  ip = 0;
+
+  // Allocate two pages at the next page boundary.
+  // Make the first inaccessible.  Use the second as the user stack.
+  sz = PGROUNDUP(sz);
+  if((sz = allocuvm(pgdir, sz, sz + 2*PGSIZE)) == 0)
+    goto bad;
+  clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
+  sp = sz;
+
+  // Push argument strings, prepare rest of stack in ustack.
+  for(argc = 0; argv[argc]; argc++) {
+    if(argc >= MAXARG)
+      goto bad;
+    sp = (sp - (strlen(argv[argc]) + 1)) & ~3;
+    if(copyout(pgdir, sp, argv[argc], strlen(argv[argc]) + 1) < 0)
+      goto bad;
+    ustack[3+argc] = sp;
+  }
+  ustack[3+argc] = 0;
+
+  ustack[0] = 0xffffffff;  // fake return PC
+  ustack[1] = argc;
+  ustack[2] = sp - (argc+1)*4;  // argv pointer
+
+  sp -= (3+argc+1) * 4;
+  if(copyout(pgdir, sp, ustack, (3+argc+1)*4) < 0)
+    goto bad;
+
+  // Save program name for debugging.
+  for(last=s=path; *s; s++)
+    if(*s == '/')
+      last = s+1;
+  safestrcpy(curproc->name, last, sizeof(curproc->name));
+
+  // Commit to the user image.
+  vmaflush(curproc, 0, KERNBASE);  //이전 이미지의 공유 파일 매핑은 파일에 쓰고 구간을 모두 지움
+  vmaremove(curproc, 0, KERNBASE);
+  for(i = 0; i < nseg; i++){  //목록을 비웠으므로 NSEG 개는 항상 들어감, 구간마다 파일 참조 하나
+    vmaadd(curproc, seg[i].vaddr, PGROUNDUP(seg[i].vaddr + seg[i].memsz),
+           i == 0 ? f : filedup(f), seg[i].off,
+           (seg[i].flags & ELF_PROG_FLAG_WRITE) ? MAP_WRITE : 0);  //코드 세그먼트는 읽기 전용
+    vmalookup(curproc, seg[i].vaddr)->filesz = seg[i].filesz;
+  }
+  f = 0;
+  oldpgdir = curproc->pgdir;
+  curproc->pgdir = pgdir;
+  curproc->sz = sz;
+  curproc->vpages = nlazy + 2; //세그먼트는 (데이터 페이지 nfill 개 빼고) 예약만, 스택과 가드 페이지 2개 할당됨
+  curproc->rss = nfill + 2;
+  curproc->nlazy = nlazy - nfill;
+  curproc->nswap = 0;
+  curproc->tf->eip = elf.entry;  // main
+  curproc->tf->esp = sp;
+  switchuvm(curproc);
+  freevm(oldpgdir);
+  return 0;
+
+ bad:
+  if(pgdir)
+    freevm(pgdir);
+  if(ip){
+    iunlockput(ip);
+    end_op();
+  }
+  if(f)
+    fileclose(f);
+  return -1;
+}
@@ -0,0 +1,8 @@
+#define O_RDONLY  0x000
+#define O_WRONLY  0x001
+#define O_RDWR    0x002
+#define O_CREATE  0x200
+
+// P4 : mmap() flags
+#define MAP_WRITE   0x001   // 쓰기 가능한 매핑 (없으면 읽기 전용)
+#define MAP_SHARED  0x002   // 쓴 내용을 파일에 반영 (없으면 프로세스 개인 복사본)
@@ -0,0 +1,170 @@
+//
+// File descriptors
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "stat.h"
+
+struct devsw devsw[NDEV];
+struct {
+  struct spinlock lock;
+  struct file file[NFILE];
+} ftable;
+
+void
+fileinit(void)
+{
+  initlock(&ftable.lock, "ftable");
+}
+
+// Allocate a file structure.
+struct file*
+filealloc(void)
+{
+  struct file *f;
+
+  acquire(&ftable.lock);
+  for(f = ftable.file; f < ftable.file + NFILE; f++){
+    if(f->ref == 0){
+      f->ref = 1;
+      release(&ftable.lock);
+      return f;
+    }
+  }
+  release(&ftable.lock);
+  return 0;
+}
+
+// Increment ref count for file f.
+struct file*
+filedup(struct file *f)
+{
+  acquire(&ftable.lock);
+  if(f->ref < 1)
+    panic("filedup");
+  f->ref++;
+  release(&ftable.lock);
+  return f;
+}
+
+// Close file f.  (Decrement ref count, close when reaches 0.)
+void
+fileclose(struct file *f)
+{
+  struct file ff;
+
+  acquire(&ftable.lock);
+  if(f->ref < 1)
+    panic("fileclose");
+  if(--f->ref > 0){
+    release(&ftable.lock);
+    return;
+  }
+  ff = *f;
+  f->ref = 0;
+  f->type = FD_NONE;
+  f->text = 0;
+  release(&ftable.lock);
+
+  if(ff.type == FD_PIPE)
+    pipeclose(ff.pipe, ff.writable);
+  else if(ff.type == FD_INODE){
+    if(ff.text){
+      ilock(ff.ip);
+      ff.ip->ntext--;
+      iunlock(ff.ip);
+    }
+    begin_op();
+    iput(ff.ip);
+    end_op();
+    ireap();
+  }
+}
+
+// Get metadata about file f.
+int
+filestat(struct file *f, struct stat *st)
+{
+  struct stat s;
+
+  if(f->type == FD_INODE){
+    ilock(f->ip);
+    stati(f->ip, &s);
+    iunlock(f->ip);
+    //사용자 버퍼 폴트 (mmap 한 같은 파일 등) 는 inode lock 을 놓고 처리
+    //읽기 전용 mmap 구간이면 커널이 폴트를 내지 않고 -1
+    return copyoutuser((uint)st, &s, sizeof(s));
+  }
+  return -1;
+}
+
+// Read from file f.
+int
+fileread(struct file *f, char *addr, int n)
+{
+  int r;
+
+  if(f->readable == 0)
+    return -1;
+  // P4 : piperead/consoleread/readi 는 lock 을 잡은 채 addr 에 쓰므로 그 전에 폴트를 처리해 둠 (vm.c pinuvm)
+  if(pinuvm(addr, n, 1) < 0)
+    return -1;
+  if(f->type == FD_PIPE)
+    r = piperead(f->pipe, addr, n);
+  else if(f->type == FD_INODE){
+    ilock(f->ip);
+    if((r = readi(f->ip, addr, f->off, n)) > 0)
+      f->off += r;
+    iunlock(f->ip);
+  } else
+    panic("fileread");
+  unpinuvm();
+  return r;
+}
+
+//PAGEBREAK!
+// Write to file f.
+int
+filewrite(struct file *f, char *addr, int n)
+{
+  int r;
+
+  if(f->writable == 0)
+    return -1;
+  // P4 : pipewrite/consolewrite/writei 도 lock 을 잡은 채 addr 을 읽음 (fileread 참고)
+  if(pinuvm(addr, n, 0) < 0)
+    return -1;
+  if(f->type == FD_PIPE){
+    r = pipewrite(f->pipe, addr, n);
+    unpinuvm();
+    return r;
+  }
+  if(f->type == FD_INODE){
+    // P4 : 한 트랜잭션에 들어갈 만큼 나눠 쓰는 것은 writei 가 함
+    // (로그를 거치는 블록 수와 파일 끝에 바로 쓰는 run 크기를 writei 가 제한하고
+    //  쓴 만큼만 리턴하므로 다 쓸 때까지 트랜잭션을 나눠서 반복)
+    int i = 0;
+    while(i < n){
+      begin_op();
+      ilock(f->ip);
+      if ((r = writei(f->ip, addr + i, f->off, n - i)) > 0)
+        f->off += r;
+      iunlock(f->ip);
+      end_op();
+
+      if(r <= 0)
+        break;
+      i += r;
+    }
+    unpinuvm();
+    return i == n ? n : -1;
+  }
+  panic("filewrite");
+}
+
@@ -3,6 +3,7 @@ struct file {
   int ref; // reference count
   char readable;
   char writable;
+  char text;     // exec 가 만든 실행 파일 참조 (inode 의 ntext 를 하나 잡고 있음)
   struct pipe *pipe;
   struct inode *ip;
   uint off;
@@ -16,6 +17,8 @@ struct inode {
   int ref;            // Reference count
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  struct inode *hnext;        // icache 해시 체인 (icache.lock 으로 보호)
+  struct inode *prev, *next;  // ref == 0 인 inode 의 LRU 리스트 (icache.lock 으로 보호)
 
   short type;         // copy of disk inode
   short major;
@@ -23,6 +26,21 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+7];
+
+  // bmap 캐시 : 마지막으로 찾아간 indirect 블록 (단계별), 0 이면 비어있음
+  // ip->lock 으로 보호되고 itrunc 에서 무효화됨
+  uint bmc_addr[2];   // [0] : 데이터 블록 주소를 담은 블록, [1] : 그 위 단계 블록
+  uint bmc_lbn[2];    // 해당 블록이 담당하는 첫 번째 논리 블록 번호
+
+  // 미리 읽기 (read-ahead) : readi 가 순차 접근을 감지하면 다음 블록들을 미리 읽기 요청
+  // bmap 캐시와 같이 ip->lock 으로 보호되고 bmc_clear 에서 초기화됨
+  uint ra_next;       // 순차 접근이라면 다음 readi 가 시작할 논리 블록
+  uint ra_win;        // 미리 읽을 블록 수 (0 이면 미리 읽지 않음)
+  uint ra_end;        // 이 논리 블록 전까지는 이미 미리 읽기를 요청함
+
+  // 이 파일을 지연 적재 중인 exec 이미지 수 (file.text 인 파일 수, ip->lock 으로 보호)
+  // 0 보다 크면 쓰기용 open 과 writei 가 실패함 (ETXTBSY) -> 실행 중 코드 페이지가 바뀌지 않음
+  int ntext;
 };
 
 // table mapping major device number to
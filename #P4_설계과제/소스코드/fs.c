@@ -22,7 +22,14 @@
 #include "file.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
+// extent 방식으로 블록을 매핑하는 inode 인지 (T_DEV 는 major 를 장치번호로 사용)
+#define ISEXTENT(ip) ((ip)->type != T_DEV && (ip)->major == IFMT_EXTENT)
+// 해시 디렉토리인지 (fs.h 참고, T_DIR 에만 사용)
+#define ISHASHDIR(dp) ((dp)->minor > 0)
 static void itrunc(struct inode*);
+static int tr_fits(struct inode*);
+static void bmc_clear(struct inode*);
+static void dcache_purge(struct inode*);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
@@ -52,46 +59,135 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// balloc 을 위한 in-memory 요약
+// 디스크는 하나만 쓰므로 sb 처럼 하나만 둠
+// nfree[i] 는 i 번째 bitmap 블록을 처음 읽을 때 셈 (그 전에는 BSUM_UNKNOWN, 부팅 때 bitmap 전체를 읽지 않음)
+// nfree[i], pend[i] 는 i 번째 bitmap 블록의 버퍼를 잡은 상태에서만 바뀌고,
+// 탐색할 때는 힌트로만 읽음 (실제 할당 여부는 bitmap 으로 다시 확인)
+// cursor 는 여러 bitmap 블록의 할당이 같이 바꾸므로 bsum.lock 으로 보호
+// pend : 아직 커밋되지 않은 트랜잭션이 해제한 블록이 있음 (tr_free)
+//   크래시가 나면 그 해제는 없던 일이 되어 원래 파일이 계속 가리키므로 로그 없이 제자리에 쓰는 wdirect 에는 주지 않음
+//   (로그를 거치는 balloc 은 해제와 같이 커밋되거나 같이 사라지므로 괜찮음)
+//   bitmap 버퍼가 B_DIRTY 가 아니게 되면 (로그가 설치됨 = 커밋됨) ballocrun 에서 지움
+#define NBITMAP (FSSIZE/BPB + 1)
+#define BSUM_UNKNOWN 0xFFFF   // 아직 세지 않은 bitmap 블록 (BPB 보다 큼)
+
+struct {
+  struct spinlock lock;     // cursor 보호
+  uint cursor;              // next-fit : 마지막으로 할당한 블록 다음부터 탐색
+  ushort nfree[NBITMAP];    // bitmap 블록별 빈 블록 수
+  uchar pend[NBITMAP];      // bitmap 블록별 커밋 전 해제 여부
+} bsum;
+
+static void
+bsuminit(int dev)
+{
+  uint i;
+
+  if(sb.size > NBITMAP*BPB)
+    panic("bsuminit: fs too big");
+  initlock(&bsum.lock, "bsum");
+  for(i = 0; i < NBITMAP; i++)
+    bsum.nfree[i] = BSUM_UNKNOWN;
+  bsum.cursor = 0;
+}
+
+// b 부터 BPB 개를 담당하는 bitmap 블록 bp 의 빈 블록 수를 아직 안 셌으면 셈
+// Caller must hold bp->lock.
+static void
+bsumcount(struct buf *bp, uint b)
+{
+  uint bi, n = 0;
+
+  if(bsum.nfree[b/BPB] != BSUM_UNKNOWN)
+    return;
+  for(bi = 0; bi < BPB && b + bi < sb.size; bi++)
+    if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+      n++;
+  bsum.nfree[b/BPB] = n;
+}
+
+// b 부터 시작하는 bitmap 블록 bp 에서 bi 번째 비트 이후의 첫 빈 블록부터
+// 최대 want 개의 연속된 빈 블록(run)을 할당하고 bitmap 은 한 번만 저널링
+// 첫 블록을 리턴하고 *got 에 할당한 개수를 기록
+// 없으면 0 리턴 (0번 블록은 boot 블록이라 할당될 일이 없음)
+static uint
+bclaim(struct buf *bp, uint b, uint bi, uint want, uint *got)
+{
+  uint n;
+
+  for(; bi < BPB && b + bi < sb.size; bi++)
+    if((bp->data[bi/8] & (1 << (bi % 8))) == 0)  // Is block free?
+      break;
+  if(bi == BPB || b + bi >= sb.size)
+    return 0;
+  for(n = 0; n < want && bi + n < BPB && b + bi + n < sb.size; n++){
+    if(bp->data[(bi+n)/8] & (1 << ((bi+n) % 8)))
+      break;
+    bp->data[(bi+n)/8] |= 1 << ((bi+n) % 8);  // Mark block in use.
+  }
+  log_write(bp);
+  bsum.nfree[b/BPB] -= n;
+  acquire(&bsum.lock);
+  bsum.cursor = b + bi + n;
+  release(&bsum.lock);
+  *got = n;
+  return b + bi;
+}
+
+// 연속된 빈 블록을 최대 want 개 할당 (내용은 0 으로 채우지 않음)
+// 한 bitmap 블록 안에서만 찾으므로 *got 은 want 보다 작을 수 있음
+// goal 이 있으면 goal 부터 (파일의 이전 블록 바로 다음 -> 디스크상 연속 배치),
+// 없으면 cursor 부터 빈 블록이 남은 bitmap 블록만 골라서 탐색 (next-fit)
+// direct 면 (wdirect) 커밋 전에 해제된 블록이 있는 bitmap 블록은 건너뛰고, 없으면 panic 대신 0 리턴
 static uint
-balloc(uint dev)
+ballocrun(uint dev, uint goal, uint want, uint *got, int direct)
 {
-  int b, bi, m;
+  uint i, n, idx, b, addr;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
+  if(goal == 0 || goal >= sb.size){
+    acquire(&bsum.lock);
+    goal = bsum.cursor;
+    release(&bsum.lock);
+  }
+  if(goal >= sb.size)
+    goal = 0;
+
+  n = (sb.size + BPB - 1) / BPB;
+  //한 바퀴 돌고 goal 이 있던 bitmap 블록의 앞부분까지 다시 확인
+  for(i = 0; i <= n; i++){
+    idx = (goal / BPB + i) % n;
+    if(bsum.nfree[idx] == 0)
+      continue;
+    b = idx * BPB;
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+    bsumcount(bp, b);
+    if(bsum.pend[idx] && (bp->flags & B_DIRTY) == 0)
+      bsum.pend[idx] = 0;
+    if(direct && bsum.pend[idx]){
+      brelse(bp);
+      continue;
     }
+    addr = bclaim(bp, b, i == 0 ? goal % BPB : 0, want, got);
     brelse(bp);
+    if(addr)
+      return addr;
   }
+  if(direct)
+    return 0;
   panic("balloc: out of blocks");
 }
 
-// Free a disk block.
-static void
-bfree(int dev, uint b)
+// Allocate a zeroed disk block.
+static uint
+balloc(uint dev, uint goal)
 {
-  struct buf *bp;
-  int bi, m;
+  uint addr, got;
 
-  bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
-  log_write(bp);
-  brelse(bp);
+  addr = ballocrun(dev, goal, 1, &got, 0);
+  bzero(dev, addr);
+  return addr;
 }
 
 // Inodes.
@@ -159,26 +255,91 @@ bfree(int dev, uint b)
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
 //
+// P4 : iget 은 (dev, inum) 해시로 찾음. ref 가 0 이 된 inode 도 해시에 남아서
+// 다시 iget 하면 디스크를 읽지 않고 그대로 쓰고 (valid 유지),
+// 새 inode 가 필요하면 LRU 리스트에서 가장 오래전에 놓인 inode 를 재사용함
+// hnext, prev, next 도 icache.lock 으로 보호됨
+//
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 1031
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+
+  // ref == 0 인 inode 들의 LRU 리스트 (prev/next)
+  // lru.next 가 가장 오래전에 놓인 것 (재사용 대상)
+  struct inode lru;
 } icache;
 
+// iput 이 넘긴 큰 파일들 (nlink 0). 각 항목이 서로 다른 icache 엔트리의 ref 를 하나씩 잡고 있으므로
+// NINODE 개를 넘지 않고, 해제가 끝날 때까지 같은 inum 으로 재사용되지 않음
+// icache.lock 으로 보호
+static struct {
+  struct inode *ip[NINODE];
+  int n;
+} itrq;
+
+// P4 : 디렉토리 이름 캐시 (dcache)
+// (dev, 디렉토리 inum, name) -> (inum, 디렉토리 안에서의 엔트리 오프셋)
+// inum 이 0 이면 그 이름이 없다는 것을 기록한 엔트리 (negative entry)
+// 해시 슬롯 하나에 엔트리 하나만 두고 충돌하면 덮어씀
+// dirlookup 에서 채우고 디렉토리 내용을 바꾸는 dirlink, sys_unlink 에서 갱신
+// 디렉토리 엔트리는 그 디렉토리의 ip->lock 을 잡고서만 바뀌므로
+// 조회/갱신하는 쪽도 dp->lock 을 잡고 있어야 함 (dcache.lock 은 테이블만 보호)
+#define NDCACHE 1024
+
+struct dentry {
+  uint dev;
+  uint dinum;           // 디렉토리 inode 번호 (0 이면 빈 슬롯)
+  uint inum;            // 0 이면 없는 이름
+  uint off;             // 디렉토리 안에서 dirent 의 오프셋
+  char name[DIRSIZ];
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry ent[NDCACHE];
+} dcache;
+
+// Caller must hold icache.lock.
+static void
+lru_remove(struct inode *ip)
+{
+  ip->next->prev = ip->prev;
+  ip->prev->next = ip->next;
+}
+
+// Caller must hold icache.lock.
+static void
+lru_append(struct inode *ip)
+{
+  ip->next = &icache.lru;
+  ip->prev = icache.lru.prev;
+  icache.lru.prev->next = ip;
+  icache.lru.prev = ip;
+}
+
 void
 iinit(int dev)
 {
   int i = 0;
   
   initlock(&icache.lock, "icache");
+  initlock(&dcache.lock, "dcache");
+  icache.lru.prev = icache.lru.next = &icache.lru;
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].lock, "inode");
+    lru_append(&icache.inode[i]);   //inum 0 : 아직 해시에 없음
   }
 
   readsb(dev, &sb);
+  bsuminit(dev);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
@@ -204,6 +365,10 @@ ialloc(uint dev, short type)
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
+#ifdef EXTENT
+      if(type == T_FILE)
+        dip->major = IFMT_EXTENT;  //새 일반 파일은 extent 방식으로 블록 매핑
+#endif
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
       return iget(dev, inum);
@@ -240,31 +405,36 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        lru_remove(ip);
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Recycle the least recently released inode cache entry.
+  if((ip = icache.lru.next) == &icache.lru)
     panic("iget: no inodes");
+  lru_remove(ip);
+  if(ip->inum != 0){
+    for(pp = &icache.hash[IHASH(ip->dev, ip->inum)]; *pp != ip; pp = &(*pp)->hnext)
+      ;
+    *pp = ip->hnext;
+  }
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = icache.hash[IHASH(dev, inum)];
+  icache.hash[IHASH(dev, inum)] = ip;
   release(&icache.lock);
   return ip;
 }
@@ -303,6 +473,7 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    bmc_clear(ip);
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -336,6 +507,17 @@ iput(struct inode *ip)
     release(&icache.lock);
     if(r == 1){
       // inode has no links and no other references: truncate and free.
+      //이 디렉토리의 dcache 엔트리 ("." ".." 포함) 를 지움 -> 같은 inum 을 받은 새 디렉토리가 보지 않도록
+      if(ip->type == T_DIR)
+        dcache_purge(ip);
+      if(!tr_fits(ip)){
+        //부른 쪽의 트랜잭션에 다 들어가지 않음 -> ref 를 itrq 로 넘기고 ireap 이 따로 해제
+        acquire(&icache.lock);
+        itrq.ip[itrq.n++] = ip;
+        release(&icache.lock);
+        releasesleep(&ip->lock);
+        return;
+      }
       itrunc(ip);
       ip->type = 0;
       iupdate(ip);
@@ -345,7 +527,8 @@ iput(struct inode *ip)
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref == 0)
+    lru_append(ip);   //해시에는 남겨두고 재사용 후보로
   release(&icache.lock);
 }
 
@@ -361,113 +544,463 @@ iunlockput(struct inode *ip)
 /**
  * P4 과제를 위한 수정
  * bn은 블록번호를 가리킴.. -> 차례차례 접근하도록 설정
+ *
+ * 순차 접근 시 같은 indirect 블록을 매번 루트부터 다시 읽지 않도록
+ * 마지막으로 찾아간 indirect 블록을 단계별로 ip->bmc_addr[] 에 캐시함
+ *   bmc_addr[0] : 데이터 블록 주소를 담은 블록 (NINDIRECT 개 블록 담당)
+ *   bmc_addr[1] : 그 위 단계 블록 (NINDIRECT*NINDIRECT 개 블록 담당)
+ * bmc_lbn[] 은 해당 블록이 담당하는 첫 번째 논리 블록 번호
 */
 
+// indirect 블록 addr 의 idx 번째 주소를 가져옴 (비어있으면 할당 후 저널링)
+// set 이 0 이 아니면 새로 할당하지 않고 set 을 기록 (이미 할당한 블록을 붙일 때)
 static uint
-bmap(struct inode *ip, uint bn)
+bmap_ind(struct inode *ip, uint addr, uint idx, uint set)
 {
-  uint addr, *a;
+  uint *a;
   struct buf *bp;
-  int idx_lvl1=-1, idx_lvl2, idx_lvl3;      //level 접근을 위한 인덱스
+
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
+  if((addr = a[idx]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
+    //바로 앞 칸이 가리키는 블록 다음 (앞 칸이 없으면 이 indirect 블록 다음) 을 우선 할당
+    if((addr = set) == 0)
+      addr = balloc(ip->dev, idx > 0 && a[idx-1] ? a[idx-1] + 1 : bp->blockno + 1);
+    a[idx] = addr;
+    log_write(bp);
+  } else if(set)
+    panic("bmap: remap");
+  brelse(bp);
+  return addr;
+}
+
+// bmap 캐시와 미리 읽기 상태 비우기 (ilock 으로 새로 읽어올 때, itrunc 할 때)
+static void
+bmc_clear(struct inode *ip)
+{
+  ip->bmc_addr[0] = ip->bmc_addr[1] = 0;
+  ip->ra_next = ip->ra_win = ip->ra_end = 0;
+}
+
+// set 은 bmap_ind 와 같음 (데이터 블록에만 적용, indirect 블록은 항상 새로 할당)
+static uint
+bmap(struct inode *ip, uint bn, uint set)
+{
+  uint addr, lbn = bn;
+  int idx;      //level 접근을 위한 인덱스
+
   if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+    if((addr = ip->addrs[bn]) == 0){
+      if((addr = set) == 0)
+        addr = balloc(ip->dev, bn > 0 && ip->addrs[bn-1] ? ip->addrs[bn-1] + 1 : 0);
+      ip->addrs[bn] = addr;
+    } else if(set)
+      panic("bmap: remap");
     return addr;
   }
+
+  //캐시된 indirect 블록이 bn 을 담당하면 바로 내려감
+  if(ip->bmc_addr[0] && bn >= ip->bmc_lbn[0] && bn - ip->bmc_lbn[0] < NINDIRECT)
+    return bmap_ind(ip, ip->bmc_addr[0], bn - ip->bmc_lbn[0], set);
+  if(ip->bmc_addr[1] && bn >= ip->bmc_lbn[1] && bn - ip->bmc_lbn[1] < NINDIRECT*NINDIRECT){
+    bn -= ip->bmc_lbn[1];
+    addr = bmap_ind(ip, ip->bmc_addr[1], bn / NINDIRECT, 0);
+    goto leaf;
+  }
+
   bn -= NDIRECT;  //첫 번째 블록만 접근
-  //level 1 블록
+  //level 1 블록 : 6,7,8,9
   if(bn < LEVEL1){
-    /*
-    int db=0;
-    for (db = 0 ; db < 13 ; db++) 
-      cprintf("ip->addrs : [%d]%d\n",db, ip->addrs[db]);
-    */
-    for (idx_lvl1 = NDIRECT ; bn >= NINDIRECT; idx_lvl1++, bn-=NINDIRECT);
+    idx = NDIRECT + bn / NINDIRECT;
     //디렉토리 할당부분
-    if((addr = ip->addrs[idx_lvl1]) == 0) {
-      ip->addrs[idx_lvl1] = addr = balloc(ip->dev); //디렉토리 생성에는 저널링을 안함
-    }
+    if((addr = ip->addrs[idx]) == 0)
+      ip->addrs[idx] = addr = balloc(ip->dev, 0); //디렉토리 생성에는 저널링을 안함
+    goto leaf;
+  }
 
-    //디스크블록을 읽는 부분
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[bn]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp); //저널링
-    }
-    brelse(bp); //저널링 풀기
-    //cprintf("my block : idx1:%d, bn:%d\n", idx_lvl1, bn);
-    return addr;
+  bn -= LEVEL1;       //3-LEVEL 메모리 : 10,11
+  if(bn < LEVEL2){
+    idx = NDIRECT + 4 + bn / (NINDIRECT*NINDIRECT);
+    if((addr = ip->addrs[idx]) == 0)
+      ip->addrs[idx] = addr = balloc(ip->dev, 0);
+    bn %= NINDIRECT*NINDIRECT;
+    goto mid;
   }
 
-  bn -= LEVEL1;       //3-LEVEL 메모리
-  if (bn < LEVEL2) {
-    for (idx_lvl2 = 6+4 ; bn >= NINDIRECT*NINDIRECT ; idx_lvl2++, bn-=NINDIRECT*NINDIRECT);
-    //idx_lvl2 할당되었는지 확인 (가장 처음 프레임)
-    if((addr = ip->addrs[idx_lvl2]) == 0)
-      ip->addrs[idx_lvl2] = addr = balloc(ip->dev); //디렉토리 생성에는 저널링을 안함
+  bn -= LEVEL2;       //4-LEVEL 메모리 : 12
+  if(bn < LEVEL3){
+    idx = NDIRECT + 6;
+    if((addr = ip->addrs[idx]) == 0)
+      ip->addrs[idx] = addr = balloc(ip->dev, 0);
+    addr = bmap_ind(ip, addr, bn / (NINDIRECT*NINDIRECT), 0);
+    bn %= NINDIRECT*NINDIRECT;
+    goto mid;
+  }
+  panic("bmap: out of range");
+
+mid:
+  //addr : NINDIRECT*NINDIRECT 개 블록을 담당하는 블록, bn : 그 안에서의 위치
+  ip->bmc_addr[1] = addr;
+  ip->bmc_lbn[1] = lbn - bn;
+  addr = bmap_ind(ip, addr, bn / NINDIRECT, 0);
+  bn %= NINDIRECT;
+leaf:
+  //addr : 데이터 블록 주소를 담은 블록
+  bn %= NINDIRECT;
+  ip->bmc_addr[0] = addr;
+  ip->bmc_lbn[0] = lbn - bn;
+  return bmap_ind(ip, addr, bn, set);
+}
 
-    for (idx_lvl1=0 ; bn >= NINDIRECT ; idx_lvl1++, bn -=NINDIRECT);
+/**
+ * Extent inode 의 블록 매핑
+ * addrs[0~11] 에는 extent 6개, addrs[12] 는 extent 가 넘칠 때 쓰는 extent 블록
+ * bn 이 속한 extent 를 찾아 디스크 블록을 리턴하고 *run 에 그 블록부터 연속된 블록 수를 기록
+ * bn 이 파일 끝 블록이면 새 블록을 할당 (직전 extent 와 이어지면 len 만 증가)
+ * set 이 0 이 아니면 새로 할당하지 않고 set 블록을 붙임
+ * extent 를 더 만들 수 없으면 0 리턴
+*/
+static uint
+ebmap(struct inode *ip, uint bn, uint *run, uint set)
+{
+  struct extent *e, *prev;
+  struct buf *bp;
+  uint addr;
+  int i, n;
 
-    //idx_lvl1 할당되었는지 확인
-    bp = bread(ip->dev, addr); //첫 번째 디렉토리 정보를 받아옴
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[idx_lvl1]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[idx_lvl1] = addr = balloc(ip->dev);
-      log_write(bp); //저널링 -> 오류 생길 수 있음!
+  bp = 0;
+  prev = 0;
+  e = (struct extent*)ip->addrs;
+  n = NEXTENT;
+  for(i = 0; ; i++){
+    if(i == n){
+      if(bp){ //extent 블록까지 가득 참
+        brelse(bp);
+        return 0;
+      }
+      if(ip->addrs[EXTBLK] == 0){ //extent 블록은 새 extent 가 필요할 때 할당
+        e = 0;
+        break;
+      }
+      bp = bread(ip->dev, ip->addrs[EXTBLK]);
+      e = (struct extent*)bp->data;
+      n = NEXTBLK;
+      i = 0;
     }
-    brelse(bp); //저널링 풀기
-
-    //idx_lvl0 실제 데이터 블록부분 가져오기
-    bp = bread(ip->dev, addr); //첫 번째 디렉토리 정보를 받아옴
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[bn]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp); //저널링 -> 오류 생길 수 있음!
+    if(e[i].len == 0) //사용되지 않은 extent -> 여기서부터 파일 끝
+      break;
+    if(bn < e[i].len){
+      addr = e[i].start + bn;
+      *run = e[i].len - bn;
+      if(bp)
+        brelse(bp);
+      return addr;
     }
-    brelse(bp); //저널링 풀기
-    return addr;
+    bn -= e[i].len;
+    prev = &e[i];
   }
 
-  bn -= LEVEL2;       //4-LEVEL 메모리
-  if (bn < LEVEL3) {
-    //addr[12] 할당되었는지 확인 (가장 처음 프레임)
-    idx_lvl3 = 6+4+2;
-    if((addr = ip->addrs[idx_lvl3]) == 0)
-      ip->addrs[idx_lvl3] = addr = balloc(ip->dev); //디렉토리 생성에는 저널링을 안함
-
-    for (idx_lvl2=0 ; bn >= NINDIRECT*NINDIRECT ; idx_lvl2++, bn -=NINDIRECT*NINDIRECT);
-    //idx_lvl2 할당되었는지 확인
-    bp = bread(ip->dev, addr); //첫 번째 디렉토리 정보를 받아옴
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[idx_lvl2]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[idx_lvl2] = addr = balloc(ip->dev);
-      log_write(bp); //저널링 -> 오류 생길 수 있음!
+  //파일 끝에 블록을 덧붙이는 경우만 가능 (xv6 파일에는 hole 이 없음)
+  if(bn != 0)
+    panic("ebmap: hole");
+
+  if((addr = set) == 0)
+    addr = balloc(ip->dev, prev ? prev->start + prev->len : 0);
+  *run = 1;
+  if(prev && prev->start + prev->len == addr){
+    prev->len++; //직전 extent 와 이어짐
+  } else {
+    if(e == 0){
+      ip->addrs[EXTBLK] = balloc(ip->dev, 0);
+      bp = bread(ip->dev, ip->addrs[EXTBLK]);
+      e = (struct extent*)bp->data;
+      i = 0;
     }
-    brelse(bp); //저널링 풀기
-
-    for (idx_lvl1=0 ; bn >= NINDIRECT ; idx_lvl1++, bn-=NINDIRECT);
-    //idx_lvl1 할당되었는지 확인
-    bp = bread(ip->dev, addr); //첫 번째 디렉토리 정보를 받아옴
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[idx_lvl1]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[idx_lvl1] = addr = balloc(ip->dev);
-      log_write(bp); //저널링 -> 오류 생길 수 있음!
+    e[i].start = addr;
+    e[i].len = 1;
+  }
+  if(bp){
+    log_write(bp);
+    brelse(bp);
+  }
+  return addr;
+}
+
+// bn 부터 디스크상 연속된 구간(run)을 한 번에 매핑
+// *run 에는 리턴한 블록부터 연속된 블록 개수가 들어감 (LEVEL 방식은 항상 1)
+static uint
+bmaprun(struct inode *ip, uint bn, uint *run)
+{
+  if(ISEXTENT(ip))
+    return ebmap(ip, bn, run, 0);
+  *run = 1;
+  return bmap(ip, bn, 0);
+}
+
+// extent 블록에 extent 를 하나 더 만들 자리가 있는지 (inode 안의 extent 는 ebmap 이 먼저 채움)
+static int
+eroom(struct inode *ip)
+{
+  struct buf *bp;
+  int r;
+
+  if(ip->addrs[EXTBLK] == 0)
+    return 1;
+  bp = bread(ip->dev, ip->addrs[EXTBLK]);
+  r = ((struct extent*)bp->data)[NEXTBLK-1].len == 0;
+  brelse(bp);
+  return r;
+}
+
+/**
+ * 파일 끝(bn)에 꽉 찬 블록 want 개를 덧붙임 (writei 의 대용량 쓰기 경로)
+ * 연속된 빈 블록 구간(run)을 bitmap 한 번 갱신으로 할당하고,
+ * 데이터 블록은 로그를 거치지 않고 제자리에 바로 씀 (0 으로 채우는 bzero 도 생략)
+ *   WRUN_NBUF 블록씩 버퍼를 잡아 디스크 요청 하나로 씀 (bwritev -> ide.c idewritev)
+ * 블록 주소를 담는 indirect/extent 블록과 inode 만 로그를 거침
+ * 데이터를 먼저 디스크에 쓰고 주소는 end_op 에서 커밋되므로 (ordered)
+ * 크래시가 나도 파일이 쓰레기 블록을 가리키는 일은 없음
+ * 커밋 전에 해제된 블록은 다시 쓰지 않음 (bsum.pend) -> 크래시로 해제가 취소돼도 원래 파일 내용이 남음
+ * 한 트랜잭션에서 건드리는 indirect 블록이 하나가 되도록 같은 indirect 블록이 담당하는 범위까지만 씀
+ * 쓴 블록 수 리턴 (extent 를 더 만들 수 없거나 바로 쓸 수 있는 빈 블록이 없으면 0)
+*/
+#define WRUNMAX NINDIRECT
+// 한 번의 디스크 요청에 쓰는 블록 수 (그동안 잡고 있는 버퍼 수, 미리 읽기 한도 bio.c RA_INFLIGHT 와 같게)
+#define WRUN_NBUF (NBUF/4)
+
+static uint
+wdirect(struct inode *ip, char *src, uint bn, uint want)
+{
+  struct buf *bp[WRUN_NBUF];
+  uint addr, goal, got, run, i, j, k;
+
+  if(ISEXTENT(ip)){
+    if(!eroom(ip))
+      return 0;
+    want = min(want, WRUNMAX);
+  } else if(bn < NDIRECT)
+    want = min(want, NDIRECT - bn);
+  else
+    want = min(want, NINDIRECT - (bn - NDIRECT) % NINDIRECT);
+
+  goal = bn > 0 ? bmaprun(ip, bn - 1, &run) + 1 : 0;
+  if((addr = ballocrun(ip->dev, goal, want, &got, 1)) == 0)
+    return 0;
+  for(i = 0; i < got; i += k){
+    k = min(got - i, WRUN_NBUF);
+    for(j = 0; j < k; j++){
+      bp[j] = getblk(ip->dev, addr + i + j);
+      memmove(bp[j]->data, src + (i + j)*BSIZE, BSIZE);
     }
-    brelse(bp); //저널링 풀기
-
-    //idx_lvl0 실제 데이터 블록부분 가져오기
-    bp = bread(ip->dev, addr); //첫 번째 디렉토리 정보를 받아옴
-    a = (uint*)bp->data; //데이터를 벡터화 (128 idx를 가지는 주소배열)
-    if((addr = a[bn]) == 0){ //막상가봤더니 없네? -> 할당 후 log 재정리
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp); //저널링 -> 오류 생길 수 있음!
+    bwritev(bp, k);
+    for(j = 0; j < k; j++)
+      brelse(bp[j]);
+  }
+  for(i = 0; i < got; i++){
+    if(ISEXTENT(ip))
+      ebmap(ip, bn + i, &run, addr + i);
+    else
+      bmap(ip, bn + i, addr + i);
+  }
+  return got;
+}
+
+//PAGEBREAK!
+/**
+ * itrunc 용 블록 해제
+ * 트랜잭션 동안 bitmap 블록들을 잡아두고 같은 bitmap 블록의 해제는 모아서 한 번만 읽고 한 번만 저널링
+ * 한 트랜잭션에서 쓰는 블록 수가 MAXOPBLOCKS 를 넘지 않도록
+ * bitmap 블록 수를 제한하고, 한도에 걸리면 거기까지만 반영한 뒤 트랜잭션을 나눔
+ *   (bitmap TRUNC_NBMAP 개 + 부분적으로 비운 indirect 블록 경로 3개 + inode 블록 1개)
+ * iput 은 부른 쪽의 트랜잭션 안에서 불리므로 그 안에서는 트랜잭션을 나눌 수 없음
+ *   -> indirect 블록 없이 bitmap 블록 TRUNC_INLINE 개 안에 끝나는 파일만 그 자리에서 해제 (itrunc)
+ *      iput 전에 부른 쪽이 쓰는 블록은 최대 3개 (unlink : dirent, 부모 inode, 자신 inode)
+ *      3 + TRUNC_INLINE + inode 블록 1개 <= MAXOPBLOCKS
+ *   -> 나머지는 itrq 에 넣어두고 트랜잭션 밖에서 ireap 이 자기 트랜잭션들로 나눠서 해제
+*/
+#define TRUNC_NBMAP   (MAXOPBLOCKS - 4)
+#define TRUNC_INLINE  2
+
+struct trunc {
+  struct inode *ip;
+  struct buf *bp[TRUNC_NBMAP];  // 이번 트랜잭션에서 잡고 있는 bitmap 블록들
+  int nbp;
+  int max;                      // 이번 트랜잭션에서 잡을 수 있는 bitmap 블록 수
+};
+
+// 잡고 있던 bitmap 블록들 저널링
+static void
+tr_flush(struct trunc *tr)
+{
+  int i;
+
+  for(i = 0; i < tr->nbp; i++){
+    log_write(tr->bp[i]);
+    brelse(tr->bp[i]);
+  }
+  tr->nbp = 0;
+}
+
+// 블록 b 해제. bitmap 블록 한도에 걸리면 해제하지 않고 0 리턴
+static int
+tr_free(struct trunc *tr, uint b)
+{
+  struct buf *bp;
+  int i, bi, m;
+
+  for(i = 0; i < tr->nbp; i++)
+    if(tr->bp[i]->blockno == BBLOCK(b, sb))
+      break;
+  if(i == tr->nbp){
+    if(tr->nbp == tr->max)
+      return 0;
+    tr->bp[tr->nbp++] = bread(tr->ip->dev, BBLOCK(b, sb));
+    bsumcount(tr->bp[i], b - b % BPB);
+  }
+  bp = tr->bp[i];
+  bi = b % BPB;
+  m = 1 << (bi % 8);
+  if((bp->data[bi/8] & m) == 0)
+    panic("freeing free block");
+  bp->data[bi/8] &= ~m;
+  bsum.nfree[b/BPB]++;
+  bsum.pend[b/BPB] = 1;
+  return 1;
+}
+
+// addr 아래의 depth 단계 트리를 모두 해제 (depth 0 : 데이터 블록)
+// 다 해제했으면 1, 중간에 멈췄으면 0 (이미 해제한 자식 주소는 0 으로 지워서 저널링)
+static int
+tr_tree(struct trunc *tr, uint addr, int depth)
+{
+  struct buf *bp;
+  uint *a;
+  int i, dirty = 0, done = 1;
+
+  if(depth == 0)
+    return tr_free(tr, addr);
+
+  bp = bread(tr->ip->dev, addr);
+  a = (uint*)bp->data;
+  for(i = 0; i < NINDIRECT; i++){
+    if(a[i] == 0)
+      continue;
+    if(!tr_tree(tr, a[i], depth - 1)){
+      done = 0;
+      break;
     }
-    brelse(bp); //저널링 풀기
+    a[i] = 0;
+    dirty = 1;
+  }
+  if(done)
+    done = tr_free(tr, addr);
+  //자기 자신까지 해제됐으면 내용은 의미없으므로 부분적으로 비운 경우만 저널링
+  if(!done && dirty)
+    log_write(bp);
+  brelse(bp);
+  return done;
+}
 
-    return addr;
+// extent 배열 e[0..n) 해제. 중간에 멈추면 남은 구간만 남도록 extent 를 줄여둠
+static int
+tr_extent(struct trunc *tr, struct extent *e, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    for(; e[i].len > 0; e[i].start++, e[i].len--)
+      if(!tr_free(tr, e[i].start))
+        return 0;
+    e[i].start = 0;
   }
-  panic("bmap: out of range");
+  return 1;
+}
+
+// 한 트랜잭션 분량만큼 inode 의 블록 해제. 다 해제했으면 1
+static int
+tr_inode(struct trunc *tr)
+{
+  struct inode *ip = tr->ip;
+  struct buf *bp;
+  int i, depth, done;
+
+  if(ISEXTENT(ip)){
+    if(!tr_extent(tr, (struct extent*)ip->addrs, NEXTENT))
+      return 0;
+    if(ip->addrs[EXTBLK]){
+      bp = bread(ip->dev, ip->addrs[EXTBLK]);
+      done = tr_extent(tr, (struct extent*)bp->data, NEXTBLK);
+      if(done)
+        done = tr_free(tr, ip->addrs[EXTBLK]);
+      else
+        log_write(bp);
+      brelse(bp);
+      if(!done)
+        return 0;
+      ip->addrs[EXTBLK] = 0;
+    }
+    return 1;
+  }
+
+  //0~5 : 직접, 6~9 : 2-level, 10,11 : 3-level, 12 : 4-level
+  for(i = 0; i < NDIRECT+7; i++){
+    if(ip->addrs[i] == 0)
+      continue;
+    if(i < NDIRECT)
+      depth = 0;
+    else if(i < NDIRECT+4)
+      depth = 1;
+    else if(i < NDIRECT+6)
+      depth = 2;
+    else
+      depth = 3;
+    if(!tr_tree(tr, ip->addrs[i], depth))
+      return 0;
+    ip->addrs[i] = 0; //다음 bmap을 위해 0으로 초기화
+  }
+  return 1;
+}
+
+// 블록 b 를 담은 bitmap 블록을 bb[0..*n) 에 추가. TRUNC_INLINE 개를 넘으면 0
+static int
+tr_fitadd(uint *bb, int *n, uint b)
+{
+  int i;
+
+  for(i = 0; i < *n; i++)
+    if(bb[i] == BBLOCK(b, sb))
+      return 1;
+  if(*n == TRUNC_INLINE)
+    return 0;
+  bb[(*n)++] = BBLOCK(b, sb);
+  return 1;
+}
+
+// 부른 쪽의 트랜잭션 안에서 한 번에 해제할 수 있는 파일인지
+// (직접 블록 / inode 안의 extent 만 쓰고 bitmap 블록 TRUNC_INLINE 개 이내)
+static int
+tr_fits(struct inode *ip)
+{
+  struct extent *e = (struct extent*)ip->addrs;
+  uint bb[TRUNC_INLINE], b;
+  int i, n = 0;
+
+  if(ISEXTENT(ip)){
+    if(ip->addrs[EXTBLK])
+      return 0;
+    for(i = 0; i < NEXTENT; i++)
+      for(b = e[i].start; b < e[i].start + e[i].len; b += BPB - b % BPB)
+        if(!tr_fitadd(bb, &n, b))
+          return 0;
+    return 1;
+  }
+  for(i = NDIRECT; i < NDIRECT+7; i++)
+    if(ip->addrs[i])
+      return 0;
+  for(i = 0; i < NDIRECT; i++)
+    if(ip->addrs[i] && !tr_fitadd(bb, &n, ip->addrs[i]))
+      return 0;
+  return 1;
 }
 
 // Truncate inode (discard contents).
@@ -475,106 +1008,71 @@ bmap(struct inode *ip, uint bn)
 // to it (no directory entries referring to it)
 // and has no in-memory reference to it (is
 // not an open file or current directory).
+// iput 을 부른 쪽의 트랜잭션 안에서 호출되므로 tr_fits 인 파일만 (큰 파일은 ireap)
 static void
 itrunc(struct inode *ip)
 {
-  int i, j, l, m;
-  struct buf *bp, *bp2, *bp3;
-  uint *a, *a2, *a3;
+  struct trunc tr;
 #ifdef JHS
   int db = 0;
   for (db = 0 ; db < 13 ; db++) 
     cprintf("[%d] [%d]->%d\n", ip->inum, db, ip->addrs[db]);
 #endif
-  //1단계 Directing Mapping 할당해제
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){ //0,1,2,3,4,5 idx에대하여 할당해제
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
-  }
+  bmc_clear(ip);
+  tr.ip = ip;
+  tr.nbp = 0;
+  tr.max = TRUNC_INLINE;
+  if(!tr_inode(&tr))
+    panic("itrunc");
+  tr_flush(&tr);
+  ip->size = 0;
+  iupdate(ip);
+}
 
-  //6,7,8,9 에 해당하는 2-level mapping system 해제
-  for (i = NDIRECT; i < NDIRECT + 4; i++) {
-    if (ip->addrs[i]) {
-      bp = bread(ip->dev, ip->addrs[i]); //페이지를 읽어옴
-      a = (uint*)bp->data;
-      //차례차례접근하며 페이지에 Indirecting 하게접근된 페이지 할당해제
-      for (j = 0; j < NINDIRECT; j++) {
-        if (a[j]) {
-          bfree(ip->dev, a[j]);
-        }
-      }
-      brelse(bp);
-      //차례차례접근하며 페이지에 Indirecting 하게접근된 페이지 디렉토리 할당해제
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0; //다음 bmap을 위해 0으로 초기화
-    }
-  }
-  //3-Level Mapping System 할당해제 () 10,11 idx
-  for (i = NDIRECT+4 ; i < NDIRECT+6 ; i++) {
-    if (ip->addrs[i]) {
-      //3단계의 가장 초기 부모 맵 페이지 접근
-      bp = bread(ip->dev, ip->addrs[i]);
-      a = (uint*)bp->data;
-      // 3단계의 2번째의 디렉토리 페이지 접근
-      for (j = 0; j < NINDIRECT; j++) {
-        //디렉토리 페이지가 있다면?
-        if (a[j]) {
-          //디렉토리 페이지를 접근하여 INDIRECING page 할당해제
-          bp2 = bread(ip->dev, a[j]);
-          a2 = (uint*)bp2->data ;
-          for (l = 0 ; l < NINDIRECT ; l++) {
-            if (a2[l]) {
-              bfree(ip->dev, a2[l]);
-            }
-          }
-          brelse(bp2); //a[j] 접근이 끝났으므로 버퍼 캐시에서 비워주기
-          bfree(ip->dev, a[j]); //2번째 디렉토리 페이지를 할당해제
-        }
-      }
-      brelse(bp);
-      bfree(ip->dev, ip->addrs[i]); //1번째 디렉토리 페이지를 할당해제
-      ip->addrs[i] = 0; //다음 bmap을 위해 0으로 초기화
+// iput 이 미뤄둔 큰 파일들을 해제하고 inode 를 반납
+// 트랜잭션 밖에서 (end_op 다음에) 불러야 함. 한 트랜잭션에 TRUNC_NBMAP 개의 bitmap 블록씩 해제
+// 중간에 크래시가 나면 nlink 0 인 inode 가 남음 (열린 채로 unlink 된 파일과 같음)
+void
+ireap(void)
+{
+  struct inode *ip;
+  struct trunc tr;
+  int done;
+
+  for(;;){
+    acquire(&icache.lock);
+    if(itrq.n == 0){
+      release(&icache.lock);
+      return;
     }
-  }
+    ip = itrq.ip[--itrq.n];
+    release(&icache.lock);
 
-  //4-Level Mapping System 할당해제 (12번 idx)
-  i = NDIRECT+6;
-  if(ip->addrs[i]){ //12번 idx가 할당되어있다면 4-Level Mapping간주
-    if (ip->addrs[i]) {
-      bp = bread(ip->dev, ip->addrs[i]); //4레벨의 첫번째 디렉토리 페이지 접근
-      a = (uint*)bp->data;
-      //하나씩 포인터로 연결해가며 4레벨의 두번째 디렉토리로 페이지 접근
-      for (j = 0; j < NINDIRECT; j++) {
-        if (a[j]) { //4레벨 디렉토리 중 2번째 디렉토리의 각 요소 포인터로 접근
-          bp2 = bread(ip->dev, a[j]);
-          a2 = (uint*)bp2->data;
-          for (l = 0 ; l < NINDIRECT ; l++) {
-            if (a2[l]) { //3번째 디렉토리 페이지가 존재한다면 마지막 진짜 Page 접근을 위해 접근
-              bp3 = bread(ip->dev, a2[l]); 
-              a3 = (uint*)bp3->data;
-              //3번째 디렉토리에서 -> 실제 페이지 할당해제를 위한 Indirecting Mapping 할당해제
-              for (m = 0 ; m < NINDIRECT ; m++) {
-                if (a3[m]){
-                  bfree(ip->dev, a3[m]); //각 실제요소 할당해제
-                }
-              }
-              brelse(bp3); //더이상 해당 3번째 디렉토리 페이지 접근이 끝나서 캐시에서 비워주기
-              bfree(ip->dev, a2[l]); //3번째 디렉토리 페이지를 할당해제
-            }
-          }
-          brelse(bp2); //더이상 2번째 디렉토리 페이지 접근이 끝나서 캐시에서 비워주기
-          bfree(ip->dev, a[j]); //2번째 디렉토리 페이지를 할당해제
-        }
+    bmc_clear(ip);
+    tr.ip = ip;
+    do{
+      begin_op();
+      acquiresleep(&ip->lock);
+      tr.nbp = 0;
+      tr.max = TRUNC_NBMAP;
+      done = tr_inode(&tr);
+      tr_flush(&tr);
+      if(done){
+        ip->size = 0;
+        ip->type = 0;
       }
-      brelse(bp); //더이상 idx 12 접근이 없으므로 캐시에서 비워주기
-      bfree(ip->dev, ip->addrs[i]); //1번째 디렉토리 (가장 앞단) 할당해제
-      ip->addrs[i] = 0; //인덱스 초기화
-    }
+      iupdate(ip);    //이번 트랜잭션에서 지운 주소까지 반영하고 커밋
+      if(done)
+        ip->valid = 0;
+      releasesleep(&ip->lock);
+      end_op();
+    } while(!done);
+
+    acquire(&icache.lock);
+    if(--ip->ref == 0)
+      lru_append(ip);
+    release(&icache.lock);
   }
-  ip->size = 0;
-  iupdate(ip);
 }
 
 // Copy stat information from inode.
@@ -590,12 +1088,35 @@ stati(struct inode *ip, struct stat *st)
 }
 
 //PAGEBREAK!
+// 미리 읽기 창 크기 (블록 수). 순차 접근이 이어지면 RA_MIN 부터 두 배씩 늘림
+// 미리 읽은 블록도 버퍼 캐시(NBUF)를 차지하므로 RA_MAX 는 NBUF 보다 충분히 작게
+// (여러 파일을 동시에 읽어도 읽는 중인 블록은 bio.c RA_INFLIGHT 개까지만)
+#define RA_MIN  2
+#define RA_MAX  8
+
+// bn 블록을 읽는 동안 그 뒤 ip->ra_win 개 블록을 미리 읽기 요청 (기다리지 않음)
+// 이미 요청한 블록(ra_end 전)은 건너뛰고 파일 끝을 넘어서는 매핑하지 않음 (bmap 이 할당하지 않도록)
+static void
+readahead(struct inode *ip, uint bn)
+{
+  uint end, addr, run;
+
+  end = min(bn + 1 + ip->ra_win, (ip->size + BSIZE - 1) / BSIZE);
+  if(ip->ra_end < bn + 1)
+    ip->ra_end = bn + 1;
+  for(run = 0, addr = 0; ip->ra_end < end; ip->ra_end++, addr++, run--){
+    if(run == 0)
+      addr = bmaprun(ip, ip->ra_end, &run);
+    bprefetch(ip->dev, addr);
+  }
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 int
 readi(struct inode *ip, char *dst, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr, run;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -609,22 +1130,47 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   if(off + n > ip->size)
     n = ip->size - off;
 
-  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+  //지난번 readi 가 끝난 블록에서 이어 읽으면 순차 접근 -> 미리 읽기 창을 늘림
+  if(off/BSIZE == ip->ra_next)
+    ip->ra_win = ip->ra_win ? min(ip->ra_win * 2, RA_MAX) : RA_MIN;
+  else
+    ip->ra_win = ip->ra_end = 0;
+
+  //연속된 구간(run)은 한 번만 매핑하고 다음 블록은 addr+1 로 바로 접근
+  for(tot=0, run=0, addr=0; tot<n; tot+=m, off+=m, dst+=m){
+    if(run == 0)
+      addr = bmaprun(ip, off/BSIZE, &run);
+    bp = bread(ip->dev, addr);
+    //현재 블록을 복사하는 동안 디스크는 다음 블록들을 읽음
+    if(ip->ra_win)
+      readahead(ip, off/BSIZE);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(dst, bp->data + off%BSIZE, m);
     brelse(bp);
+    if((off + m) % BSIZE == 0){
+      addr++;
+      run--;
+    }
   }
+  ip->ra_next = off/BSIZE;
   return n;
 }
 
 // PAGEBREAK!
+// writei 한 번(트랜잭션 하나)에서 로그를 거쳐 쓰는 데이터 블록 수
+// inode, indirect, bitmap 블록과 정렬 안된 쓰기를 위한 여유 2블록을 빼고 남는 만큼
+#define WLOGBLK ((MAXOPBLOCKS-1-1-2) / 2)
+
 // Write data to inode.
 // Caller must hold ip->lock.
+// 한 트랜잭션에 들어가는 만큼만 쓰고 쓴 바이트 수를 리턴하므로 n 보다 적을 수 있음
+// (나머지는 filewrite, vmawrite 가 다음 트랜잭션에서 이어서 씀)
+// 한 블록도 못 쓰면 0 이 아니라 -1. 블록 하나 안에 들어가는 쓰기 (dirlink, unlink 의 dirent) 는 나눠지지 않음
 int
 writei(struct inode *ip, char *src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr, run, nlog;
+  int direct = 1;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -637,20 +1183,46 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  if(ip->ntext > 0)   //실행 중인 프로그램 파일 (file.h)
+    return -1;
 
-  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+  for(tot=0, run=0, addr=0, nlog=0; tot<n; tot+=m, off+=m, src+=m){
+    //파일 끝에 꽉 찬 블록을 덧붙이는 경우 : 데이터 블록은 로그를 거치지 않음
+    //(off 가 파일 끝 이후이고 블록 경계이면 그 블록은 아직 할당되지 않음)
+    if(direct && off % BSIZE == 0 && off >= ip->size && n - tot >= BSIZE){
+      if(nlog > 0)
+        break;
+      if((m = wdirect(ip, src, off/BSIZE, (n - tot)/BSIZE)) > 0){
+        m *= BSIZE;
+        tot += m;
+        off += m;
+        break;  //run 하나가 트랜잭션 하나
+      }
+      direct = 0;  //바로 쓸 블록이 없으면 로그를 거쳐 씀 (extent 를 더 만들 수 없으면 아래 bmaprun 도 실패)
+    }
+    if(nlog == WLOGBLK)
+      break;
+    if(run == 0 && (addr = bmaprun(ip, off/BSIZE, &run)) == 0)
+      break; //extent 를 더 만들 수 없음
+    bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
+    nlog++;
     log_write(bp);
     brelse(bp);
+    if((off + m) % BSIZE == 0){
+      addr++;
+      run--;
+    }
   }
 
-  if(n > 0 && off > ip->size){
+  if(tot > 0 && off > ip->size){
     ip->size = off;
     iupdate(ip);
   }
-  return n;
+  if(tot == 0 && n > 0)
+    return -1;
+  return tot;
 }
 
 //PAGEBREAK!
@@ -662,6 +1234,269 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// 이름 해시 (해시 디렉토리의 버킷 선택, dcache 슬롯 선택)
+// mkfs.c 의 dirhash 와 같아야 함
+static uint
+dirhash(char *name)
+{
+  uint h = 0;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h;
+}
+
+static struct dentry*
+dcache_slot(struct inode *dp, char *name)
+{
+  return &dcache.ent[(dirhash(name) + dp->inum * 31 + dp->dev) % NDCACHE];
+}
+
+// dcache 에서 dp 안의 name 을 찾음. 있으면 1 (*inum 이 0 이면 없는 이름)
+// Caller must hold dp->lock.
+static int
+dcache_lookup(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dentry *d;
+  int hit = 0;
+
+  acquire(&dcache.lock);
+  d = dcache_slot(dp, name);
+  if(d->dinum == dp->inum && d->dev == dp->dev && namecmp(d->name, name) == 0){
+    *inum = d->inum;
+    *off = d->off;
+    hit = 1;
+  }
+  release(&dcache.lock);
+  return hit;
+}
+
+// dp 안의 name 이 off 에 있는 inum 임을 기록 (inum 0 : 없는 이름)
+// Caller must hold dp->lock.
+void
+dcache_enter(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  d = dcache_slot(dp, name);
+  d->dev = dp->dev;
+  d->dinum = dp->inum;
+  d->inum = inum;
+  d->off = off;
+  strncpy(d->name, name, DIRSIZ);
+  release(&dcache.lock);
+}
+
+// dp 의 dcache 엔트리를 모두 지움 (hdirsplit 으로 엔트리 오프셋이 바뀜, iput 으로 디렉토리가 지워짐)
+// Caller must hold dp->lock.
+static void
+dcache_purge(struct inode *dp)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.ent; d < &dcache.ent[NDCACHE]; d++)
+    if(d->dinum == dp->inum && d->dev == dp->dev)
+      d->dinum = 0;
+  release(&dcache.lock);
+}
+
+// 디렉토리의 [off, end) 구간에서 name 을 찾아 inum 리턴 (없으면 0), 찾으면 *poff 에 오프셋
+// 처음 만난 빈 칸을 *pfree 에 (아직 없었으면), 한 번도 쓰이지 않은 칸을 만나면 *fresh 에 기록
+// live 가 있으면 쓰이고 있는 칸 수를 더함 (name 을 찾으면 거기서 멈추므로 다 세지 않음)
+// off 는 블록 경계이고 블록 단위로 bread 해서 그 안의 dirent 들을 비교
+static uint
+hdirscan(struct inode *dp, char *name, uint off, uint end, uint *poff, uint *pfree, int *fresh, int *live)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint run, inum = 0;
+  int i;
+
+  for(; inum == 0 && off < end; off += BSIZE){
+    bp = bread(dp->dev, bmaprun(dp, off/BSIZE, &run));
+    de = (struct dirent*)bp->data;
+    for(i = 0; i < DPB && off + i*sizeof(*de) < end; i++){
+      if(de[i].inum == 0){
+        if(*pfree == ~0)
+          *pfree = off + i*sizeof(*de);
+        if(de[i].name[0] == 0)
+          *fresh = 1;
+        continue;
+      }
+      if(live)
+        (*live)++;
+      if(namecmp(name, de[i].name) == 0){
+        if(poff)
+          *poff = off + i*sizeof(*de);
+        inum = de[i].inum;
+        break;
+      }
+    }
+    brelse(bp);
+  }
+  return inum;
+}
+
+// 이름 해시 h 가 들어갈 버킷 (버킷 nb 개, linear hashing)
+// m 을 nb 이상인 가장 작은 2 의 거듭제곱이라 하면 h % m, 그 버킷이 아직 없으면 (아직 나눠지지 않음) h % (m/2)
+// nb 가 2 의 거듭제곱이면 h % nb 와 같음 (mkfs 가 만든 루트 디렉토리)
+static uint
+hbucket(uint h, uint nb)
+{
+  uint m;
+
+  for(m = 1; m < nb; m <<= 1)
+    ;
+  if(h % m < nb)
+    return h % m;
+  return h % (m >> 1);
+}
+
+// 해시 디렉토리에서 name 을 찾아 inum 리턴 (없으면 0), 찾으면 *poff 에 오프셋
+// *pfree 에는 name 을 넣을 자리 (버킷의 첫 빈 칸, 없으면 덧붙인 영역의 첫 빈 칸, 그것도 없으면 파일 끝)
+// *live 에는 name 이 들어갈 버킷에서 쓰이고 있는 칸 수 (dirlink 가 버킷을 늘릴지 정함)
+// name 이 들어갈 버킷 블록 하나만 읽고, 그 버킷이 넘친 적이 있을 때만 덧붙인 영역을 찾음
+static uint
+hdirfind(struct inode *dp, char *name, uint *poff, uint *pfree, int *live)
+{
+  uint nb, b, inum, free = ~0;
+  int fresh = 0, n = 0;
+
+  nb = dp->minor;
+  if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0){
+    //"." 와 ".." 는 블록 0 의 처음 두 칸
+    inum = hdirscan(dp, name, 0, 2*sizeof(struct dirent), poff, &free, &fresh, 0);
+    goto out;
+  }
+  b = hbucket(dirhash(name), nb);
+  inum = hdirscan(dp, name, b*BSIZE, (b+1)*BSIZE, poff, &free, &fresh, &n);
+  if(inum || fresh) //fresh : 이 버킷은 넘친 적이 없으므로 덧붙인 영역에는 없음
+    goto out;
+  //버킷이 넘친 적이 있음 : 버킷 뒤에 덧붙인 영역을 선형으로 찾음
+  inum = hdirscan(dp, name, nb*BSIZE, dp->size, poff, &free, &fresh, 0);
+out:
+  if(pfree)
+    *pfree = free == ~0 ? dp->size : free;
+  if(live)
+    *live = n;
+  return inum;
+}
+
+// 디렉토리 (블록 매핑은 항상 level 방식) 의 이미 있는 bn 번째 블록을 addr 로 바꿈 (hdirsplit)
+static void
+bremap(struct inode *ip, uint bn, uint addr)
+{
+  struct buf *bp;
+
+  if(ISEXTENT(ip))
+    panic("bremap");
+  if(bn < NDIRECT){
+    ip->addrs[bn] = addr;
+    return;
+  }
+  bmap(ip, bn, 0);  //bn 을 담당하는 indirect 블록이 bmc_addr[0] 에 캐시됨
+  bp = bread(ip->dev, ip->bmc_addr[0]);
+  ((uint*)bp->data)[bn - ip->bmc_lbn[0]] = addr;
+  log_write(bp);
+  brelse(bp);
+}
+
+/**
+ * 해시 디렉토리 dp 의 버킷을 하나 늘림 (linear hashing 분할)
+ * 새 버킷은 nb(= minor) 번, 나눠지는 버킷은 nb - 2^k 번 (2^k 는 nb 이하인 가장 큰 2 의 거듭제곱)
+ * 나눠지는 버킷에서 새 버킷 번호로 가야 하는 엔트리만 옮김 (옮긴 칸은 지운 엔트리처럼 이름을 남김)
+ * 나눠지는 버킷이 넘친 적이 있으면 덧붙인 영역에 새 버킷 몫이 있을 수 있으므로 새 버킷의 빈 칸도 쓰인 적 있는 칸으로 표시
+ * 덧붙인 영역이 있으면 그 첫 블록 (블록 nb) 을 주소만 바꿔 파일 끝으로 옮기고 그 자리에 새 버킷을 둠
+ * 새 버킷 블록은 wdirect 처럼 로그 없이 바로 쓰고 (주소는 end_op 에서 커밋) 로그에는
+ * 나눠지는 버킷, bitmap, indirect, inode 블록만 들어가므로 한 트랜잭션 (dirlink) 안에서 처리됨
+ * 버킷을 더 늘릴 수 없으면 0
+*/
+#define HDIRSPLIT  (DPB*3/4)   // 넣을 버킷이 이만큼 차 있으면 dirlink 가 버킷을 늘림
+#define HDIRMAX    32767       // 버킷 수는 dinode.minor (short) 에 기록
+
+static int
+hdirsplit(struct inode *dp)
+{
+  uint nb = dp->minor, p, src, last, addr, got;
+  struct buf *bp, *nbp;
+  struct dirent *de, *nde;
+  int i, j, direct, fresh = 0;
+
+  if(nb >= HDIRMAX)
+    return 0;
+  for(p = 1; p * 2 <= nb; p <<= 1)
+    ;
+  src = nb - p;
+  last = (dp->size + BSIZE - 1) / BSIZE;  //덧붙인 영역 다음 블록 (덧붙인 영역이 없으면 nb)
+  if(last >= MAXFILE)
+    return 0;
+
+  //새 버킷 블록 : 커밋 전에 해제된 블록이 아닌 빈 블록이 있으면 로그 없이 씀
+  if((direct = (addr = ballocrun(dp->dev, 0, 1, &got, 1)) != 0))
+    nbp = getblk(dp->dev, addr);
+  else {
+    addr = balloc(dp->dev, 0);
+    nbp = bread(dp->dev, addr);
+  }
+  memset(nbp->data, 0, BSIZE);
+  nde = (struct dirent*)nbp->data;
+
+  bp = bread(dp->dev, bmap(dp, src, 0));
+  de = (struct dirent*)bp->data;
+  for(i = 0, j = 0; i < DPB; i++){
+    if(de[i].inum == 0){
+      if(de[i].name[0] == 0)
+        fresh = 1;
+      continue;
+    }
+    if(src == 0 && i < 2)  //"." 와 ".."
+      continue;
+    if(hbucket(dirhash(de[i].name), nb + 1) == nb){
+      nde[j++] = de[i];
+      de[i].inum = 0;
+    }
+  }
+  if(!fresh)
+    for(; j < DPB; j++)
+      nde[j].name[0] = '/';  //쓰인 적 있는 빈 칸 (이름에는 '/' 가 없음)
+  log_write(bp);
+  brelse(bp);
+  if(direct)
+    bwrite(nbp);
+  else
+    log_write(nbp);
+  brelse(nbp);
+
+  if(last > nb){
+    bmap(dp, last, bmap(dp, nb, 0));  //덧붙인 영역의 첫 블록을 파일 끝으로
+    bremap(dp, nb, addr);
+    dp->size = (last + 1) * BSIZE;
+  } else {
+    bmap(dp, nb, addr);
+    dp->size = (nb + 1) * BSIZE;
+  }
+  dp->minor = nb + 1;
+  iupdate(dp);
+  dcache_purge(dp);
+  return 1;
+}
+
+// P4 : 빈 디렉토리 dp 를 버킷 하나짜리 해시 디렉토리로 만듦 (create 에서 "." 와 ".." 를 넣기 전)
+// Caller must hold dp->lock.
+void
+hdirinit(struct inode *dp)
+{
+  if(dp->type != T_DIR || dp->size != 0)
+    panic("hdirinit");
+  bmap(dp, 0, 0);  //0 으로 채운 블록 (balloc)
+  dp->size = BSIZE;
+  dp->minor = 1;
+  iupdate(dp);
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
@@ -673,6 +1508,24 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dcache_lookup(dp, name, &inum, &off)){
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
+  if(ISHASHDIR(dp)){
+    inum = hdirfind(dp, name, &off, 0, 0);
+    dcache_enter(dp, name, inum, inum ? off : 0);
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -683,10 +1536,12 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       if(poff)
         *poff = off;
       inum = de.inum;
+      dcache_enter(dp, name, inum, off);
       return iget(dp->dev, inum);
     }
   }
 
+  dcache_enter(dp, name, 0, 0);
   return 0;
 }
 
@@ -694,7 +1549,8 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
+  uint off;
+  int live;
   struct dirent de;
   struct inode *ip;
 
@@ -705,7 +1561,12 @@ dirlink(struct inode *dp, char *name, uint inum)
   }
 
   // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
+  // 해시 디렉토리 : 넣을 버킷이 3/4 이상 차 있으면 버킷을 하나 늘리고 (차례가 된 버킷이 나눠짐) 다시 찾음
+  if(ISHASHDIR(dp)){
+    hdirfind(dp, name, 0, &off, &live);
+    if(live >= HDIRSPLIT && hdirsplit(dp))
+      hdirfind(dp, name, 0, &off, 0);
+  } else for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlink read");
     if(de.inum == 0)
@@ -716,6 +1577,7 @@ dirlink(struct inode *dp, char *name, uint inum)
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
+  dcache_enter(dp, name, inum, off);
 
   return 0;
 }
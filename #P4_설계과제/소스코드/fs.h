@@ -7,7 +7,7 @@
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//                                          free bit map | swap | data blocks]
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -19,6 +19,8 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint swapstart;    // 스왑 영역 첫 블록 번호 (P4)
+  uint nswap;        // 스왑 영역 블록 수 (비트맵에는 사용 중으로 표시됨)
 };
 
 //#define NDIRECT 12
@@ -40,6 +42,22 @@ struct dinode {
   uint addrs[NDIRECT+7];   // Data block addresses
 };
 
+// 블록 매핑 방식 (dinode.major 는 T_DEV 에서만 쓰이므로 일반 파일은 여기에 매핑 방식을 기록)
+#define IFMT_LEVEL    0   // NDIRECT + LEVEL1 + LEVEL2 + LEVEL3 (기존 방식)
+#define IFMT_EXTENT   1   // (시작블록, 길이) extent 배열
+
+// Extent : 디스크상 연속된 블록 구간 하나
+// 논리 블록 번호는 앞선 extent 들의 len 합으로 결정됨 (xv6 파일에는 hole 이 없음)
+struct extent {
+  uint start;           // 첫 번째 디스크 블록 번호
+  uint len;             // 연속된 블록 개수
+};
+
+#define NEXTENT     ((NDIRECT+6) / 2)                 // addrs[0~11] 에 들어가는 extent 개수
+#define EXTBLK      (NDIRECT+6)                       // addrs[12] : extent 가 넘칠 때 쓰는 extent 블록
+#define NEXTBLK     (BSIZE / sizeof(struct extent))   // extent 블록 하나에 들어가는 extent 개수
+#define MAXEXTENT   (NEXTENT + NEXTBLK)
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -60,3 +78,15 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+#define DPB           (BSIZE / sizeof(struct dirent))   // 블록 하나에 들어가는 dirent 개수
+
+// 해시 디렉토리 : T_DIR 이고 dinode.minor 가 0 이 아니면 블록 0 ~ minor-1 이 버킷인 해시 디렉토리
+// 이름은 linear hashing 으로 고른 버킷 블록에 넣음 (fs.c hbucket, minor 가 2 의 거듭제곱이면 dirhash(name) % minor)
+// 버킷이 가득 차면 버킷들 뒤(블록 minor 부터 파일 끝)에 선형 디렉토리처럼 덧붙임
+// 버킷이 3/4 이상 차면 차례가 된 버킷 하나를 둘로 나눠 버킷 수를 하나 늘림 (fs.c hdirsplit)
+// 버킷도 보통 dirent 배열이므로 디렉토리를 선형으로 읽는 코드(ls 등)는 그대로 동작함
+// "." 와 ".." 는 선형 디렉토리처럼 블록 0 의 처음 두 칸에 둠
+// 지운 엔트리는 이름을 남겨서 (inum 0, name[0] != 0) 한 번도 쓰이지 않은 칸 (name[0] == 0) 과 구분
+// -> 한 번도 쓰이지 않은 칸이 있는 버킷은 넘친 적이 없으므로 덧붙인 영역까지 찾을 필요 없음
+// 커널이 만드는 디렉토리 (mkdir) 는 버킷 하나짜리 해시 디렉토리로 시작함
+
@@ -0,0 +1,255 @@
+// Simple PIO-based (non-DMA) IDE driver code.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "traps.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+#define SECTOR_SIZE   512
+#define IDE_BSY       0x80
+#define IDE_DRDY      0x40
+#define IDE_DF        0x20
+#define IDE_ERR       0x01
+
+#define IDE_CMD_READ  0x20
+#define IDE_CMD_WRITE 0x30
+#define IDE_CMD_RDMUL 0xc4
+#define IDE_CMD_WRMUL 0xc5
+
+// idequeue points to the buf now being read/written to the disk.
+// idequeue->qnext points to the next buf to be processed.
+// You must hold idelock while manipulating queue.
+
+static struct spinlock idelock;
+static struct buf *idequeue;
+
+// P4 : 여러 블록 쓰기 (idewritev) 에서 아직 디스크로 보내지 않은 다음 블록
+// 명령 하나로 연속된 섹터들을 쓰고, 섹터마다 오는 인터럽트에서 다음 블록을 보냄
+static struct buf *idenext;
+
+static int havedisk1;
+static void idestart(struct buf*);
+
+// Wait for IDE disk to become ready.
+static int
+idewait(int checkerr)
+{
+  int r;
+
+  while(((r = inb(0x1f7)) & (IDE_BSY|IDE_DRDY)) != IDE_DRDY)
+    ;
+  if(checkerr && (r & (IDE_DF|IDE_ERR)) != 0)
+    return -1;
+  return 0;
+}
+
+void
+ideinit(void)
+{
+  int i;
+
+  initlock(&idelock, "ide");
+  ioapicenable(IRQ_IDE, ncpu - 1);
+  idewait(0);
+
+  // Check if disk 1 is present
+  outb(0x1f6, 0xe0 | (1<<4));
+  for(i=0; i<1000; i++){
+    if(inb(0x1f7) != 0){
+      havedisk1 = 1;
+      break;
+    }
+  }
+
+  // Switch back to disk 0.
+  outb(0x1f6, 0xe0 | (0<<4));
+}
+
+// Start the request for b.  Caller must hold idelock.
+static void
+idestart(struct buf *b)
+{
+  if(b == 0)
+    panic("idestart");
+  if(b->blockno >= FSSIZE)
+    panic("incorrect blockno");
+  int sector_per_block =  BSIZE/SECTOR_SIZE;
+  int sector = b->blockno * sector_per_block;
+  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
+
+  int nsect = sector_per_block;
+  struct buf *r;
+
+  if (sector_per_block > 7) panic("idestart");
+  for(r = b->rnext; r; r = r->rnext)  //idewritev : 이어지는 블록들까지 한 명령으로
+    nsect += sector_per_block;
+
+  idewait(0);
+  outb(0x3f6, 0);  // generate interrupt
+  outb(0x1f2, nsect);  // number of sectors
+  outb(0x1f3, sector & 0xff);
+  outb(0x1f4, (sector >> 8) & 0xff);
+  outb(0x1f5, (sector >> 16) & 0xff);
+  outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
+  if(b->flags & B_DIRTY){
+    outb(0x1f7, write_cmd);
+    outsl(0x1f0, b->data, BSIZE/4);
+    idenext = b->rnext;
+  } else {
+    outb(0x1f7, read_cmd);
+  }
+}
+
+// Interrupt handler.
+void
+ideintr(void)
+{
+  struct buf *b;
+
+  // First queued buffer is the active request.
+  acquire(&idelock);
+
+  if((b = idequeue) == 0){
+    release(&idelock);
+    return;
+  }
+  // P4 : 여러 블록 쓰기 중 한 섹터가 끝남 -> 같은 명령의 다음 블록을 보냄
+  if(idenext){
+    idewait(0);
+    outsl(0x1f0, idenext->data, BSIZE/4);
+    idenext = idenext->rnext;
+    release(&idelock);
+    return;
+  }
+  idequeue = b->qnext;
+
+  // Read data if needed.
+  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
+    insl(0x1f0, b->data, BSIZE/4);
+
+  // Wake process waiting for this buf.
+  b->flags |= B_VALID;
+  b->flags &= ~(B_DIRTY|B_ASYNC);
+  wakeup(b);
+  for(b = b->rnext; b; b = b->rnext)  //같은 요청으로 쓴 블록들
+    b->flags &= ~B_DIRTY;
+
+  // Start disk on next buf in queue.
+  if(idequeue != 0)
+    idestart(idequeue);
+
+  release(&idelock);
+}
+
+// Append b to idequeue and start disk if necessary.
+// Caller must hold idelock.
+static void
+idequeueadd(struct buf *b)
+{
+  struct buf **pp;
+
+  b->qnext = 0;
+  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
+    ;
+  *pp = b;
+
+  // Start disk if necessary.
+  if(idequeue == b)
+    idestart(b);
+}
+
+//PAGEBREAK!
+// Sync buf with disk.
+// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+// Else if B_VALID is not set, read buf from disk, set B_VALID.
+void
+iderw(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("iderw: buf not locked");
+  if(b->dev != 0 && !havedisk1)
+    panic("iderw: ide disk 1 not present");
+
+  acquire(&idelock);  //DOC:acquire-lock
+
+  // P4 : 미리 읽기로 이미 큐에 들어간 블록은 다시 넣지 않고 끝나기만 기다림
+  // (bread 가 B_VALID 를 본 뒤 여기 오기 전에 읽기가 끝났을 수도 있으므로 idelock 을 잡고 확인)
+  if((b->flags & B_ASYNC) == 0){
+    if((b->flags & (B_VALID|B_DIRTY)) == B_VALID){
+      release(&idelock);
+      return;
+    }
+    idequeueadd(b);
+  }
+
+  // Wait for request to finish.
+  while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
+    sleep(b, &idelock);
+  }
+
+
+  release(&idelock);
+}
+
+// P4 : 디스크상 연속된 블록 b[0..n) 을 쓰기 명령 하나로 씀 (끝날 때까지 기다림)
+// 블록마다 요청을 따로 넣으면 블록마다 명령을 내고 끝나기를 기다리게 됨
+// 블록 하나가 섹터 여러 개면 (RDMUL/WRMUL) 섹터 단위로 나눠 보낼 수 없으므로 블록마다 따로 씀
+// Caller must hold b[i]->lock and have set B_DIRTY.
+void
+idewritev(struct buf **b, int n)
+{
+  int i;
+
+  if(BSIZE != SECTOR_SIZE || n == 1){
+    for(i = 0; i < n; i++)
+      iderw(b[i]);
+    return;
+  }
+  if(n > 255)
+    panic("idewritev");
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&b[i]->lock) || !(b[i]->flags & B_DIRTY))
+      panic("idewritev: buf");
+    if(i > 0 && b[i]->blockno != b[i-1]->blockno + 1)
+      panic("idewritev: not contiguous");
+    b[i]->rnext = i + 1 < n ? b[i+1] : 0;
+  }
+  if(b[0]->dev != 0 && !havedisk1)
+    panic("iderw: ide disk 1 not present");
+
+  acquire(&idelock);
+  idequeueadd(b[0]);
+  while((b[0]->flags & (B_VALID|B_DIRTY)) != B_VALID)
+    sleep(b[0], &idelock);
+  for(i = 0; i < n; i++)
+    b[i]->rnext = 0;
+  release(&idelock);
+}
+
+// P4 : 미리 읽기. b 를 읽도록 큐에 넣기만 하고 기다리지 않음
+// 읽는 동안 B_ASYNC 가 켜져 있고 ideintr 에서 끝나면 B_VALID 로 바뀜
+// Caller must hold b->lock.
+void
+ideread_async(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("ideread_async: buf not locked");
+  if(b->dev != 0 && !havedisk1)
+    return;
+
+  acquire(&idelock);
+  if((b->flags & (B_VALID|B_DIRTY|B_ASYNC)) == 0){
+    b->flags |= B_ASYNC;
+    idequeueadd(b);
+  }
+  release(&idelock);
+}
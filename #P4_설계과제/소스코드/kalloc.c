@@ -0,0 +1,202 @@
+// Physical memory allocator, intended to allocate
+// memory for user processes, kernel stacks, page table pages,
+// and pipe buffers. Allocates 4096-byte pages.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+void freerange(void *vstart, void *vend);
+extern char end[]; // first address after kernel loaded from ELF file
+                   // defined by the kernel linker script in kernel.ld
+
+struct run {
+  struct run *next;
+};
+
+struct {
+  struct spinlock lock;
+  int use_lock;
+  struct run *freelist;
+  int nfree;  // P4 : 빈 페이지 수 (스왑 데몬 기준)
+  // P4 : 물리 페이지별 참조 횟수 (copy-on-write fork 로 여러 페이지 테이블이 한 페이지를 공유)
+  // kalloc 이 1 로 만들고, kfree 는 1 씩 줄이다가 0 이 될 때만 실제로 해제
+  ushort ref[PHYSTOP/PGSIZE];
+} kmem;
+
+// P4 : lazy 페이지를 읽기만 할 때 공유하는 0 으로 채워진 페이지 (커널 bss 라 부팅 시 0)
+// 항상 읽기 전용 + PTE_COW 로만 매핑되고 참조 횟수는 세지 않음 (kfree/kincref 는 무시)
+char zeropage[PGSIZE] __attribute__((aligned(PGSIZE)));
+
+// Initialization happens in two phases.
+// 1. main() calls kinit1() while still using entrypgdir to place just
+// the pages mapped by entrypgdir on free list.
+// 2. main() calls kinit2() with the rest of the physical pages
+// after installing a full page table that maps them on all cores.
+void
+kinit1(void *vstart, void *vend)
+{
+  initlock(&kmem.lock, "kmem");
+  kmem.use_lock = 0;
+  freerange(vstart, vend);
+}
+
+void
+kinit2(void *vstart, void *vend)
+{
+  freerange(vstart, vend);
+  kmem.use_lock = 1;
+}
+
+void
+freerange(void *vstart, void *vend)
+{
+  char *p;
+  p = (char*)PGROUNDUP((uint)vstart);
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
+    kmem.ref[V2P(p)/PGSIZE] = 1;
+    kfree(p);
+  }
+}
+//PAGEBREAK: 21
+// Free the page of physical memory pointed at by v,
+// which normally should have been returned by a
+// call to kalloc().  (The exception is when
+// initializing the allocator; see kinit above.)
+// P4 : 공유 중인 페이지면 참조 횟수만 줄임
+void
+kfree(char *v)
+{
+  struct run *r;
+
+  if(v == zeropage)
+    return;
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kfree");
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] == 0)
+    panic("kfree: ref");
+  if(kmem.ref[V2P(v)/PGSIZE] > 1){
+    kmem.ref[V2P(v)/PGSIZE]--;
+    if(kmem.use_lock)
+      release(&kmem.lock);
+    return;
+  }
+  if(kmem.use_lock)
+    release(&kmem.lock);
+
+  // Fill with junk to catch dangling refs.
+  memset(v, 1, PGSIZE);
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  //freelist 에 넣을 때 0 으로 만듦 -> ref 가 0 인 페이지는 항상 freelist 에 있음 (ksuperalloc)
+  kmem.ref[V2P(v)/PGSIZE] = 0;
+  r = (struct run*)v;
+  r->next = kmem.freelist;
+  kmem.freelist = r;
+  kmem.nfree++;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+char*
+kalloc(void)
+{
+  struct run *r;
+  int low;
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  r = kmem.freelist;
+  if(r){
+    kmem.freelist = r->next;
+    kmem.ref[V2P(r)/PGSIZE] = 1;
+    kmem.nfree--;
+  }
+  low = kmem.nfree < SWAPLOW;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  if(low && kmem.use_lock)
+    swapwake();  // P4 : 빈 페이지가 모자라면 스왑 데몬이 미리 내보내도록
+  return (char*)r;
+}
+
+// P4 : 4MB 경계에 맞춘 연속된 빈 물리 페이지 NPTENTRIES 개 (PTE_PS superpage 용, vm.c superuvm)
+// 각 페이지의 참조 횟수는 1 이므로 kfree 로 4KB 씩 따로 돌려줄 수 있음
+// 그런 구간이 없거나 가져가면 빈 페이지가 SWAPHIGH 보다 적어지면 0 (호출한 쪽은 4KB 페이지로 처리)
+char*
+ksuperalloc(void)
+{
+  struct run **pp;
+  uint pa, i;
+
+  acquire(&kmem.lock);
+  if(kmem.nfree < NPTENTRIES + SWAPHIGH){
+    release(&kmem.lock);
+    return 0;
+  }
+  for(pa = SPGROUNDDOWN(V2P(end) + SPGSIZE - 1); pa + SPGSIZE <= PHYSTOP; pa += SPGSIZE){
+    for(i = 0; i < NPTENTRIES && kmem.ref[pa/PGSIZE + i] == 0; i++)
+      ;
+    if(i == NPTENTRIES)
+      break;
+  }
+  if(pa + SPGSIZE > PHYSTOP){
+    release(&kmem.lock);
+    return 0;
+  }
+  //freelist 에서 이 구간의 페이지들을 빼냄 (드물게 불리므로 freelist 를 한 번 훑음)
+  for(pp = &kmem.freelist; *pp; ){
+    if(V2P(*pp) >= pa && V2P(*pp) < pa + SPGSIZE)
+      *pp = (*pp)->next;
+    else
+      pp = &(*pp)->next;
+  }
+  for(i = 0; i < NPTENTRIES; i++)
+    kmem.ref[pa/PGSIZE + i] = 1;
+  kmem.nfree -= NPTENTRIES;
+  release(&kmem.lock);
+  return P2V(pa);
+}
+
+// P4 : 페이지 v 를 공유하는 페이지 테이블이 하나 늘어남 (copyuvm)
+void
+kincref(char *v)
+{
+  if(v == zeropage)
+    return;
+  acquire(&kmem.lock);
+  if(kmem.ref[V2P(v)/PGSIZE] == 0)
+    panic("kincref");
+  kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.lock);
+}
+
+// P4 : 페이지 v 를 공유하는 페이지 테이블 수
+int
+krefcnt(char *v)
+{
+  int n;
+
+  acquire(&kmem.lock);
+  n = kmem.ref[V2P(v)/PGSIZE];
+  release(&kmem.lock);
+  return n;
+}
+
+
+// P4 : 빈 물리 페이지 수 (스왑 데몬)
+int
+kfreecount(void)
+{
+  return kmem.nfree;
+}
@@ -0,0 +1,8 @@
+// P4 : memstat() 시스템 콜이 돌려주는 프로세스 메모리 사용량 (단위 : 페이지)
+struct memstat {
+  uint vpages;  // 가상 페이지 수 (getvp 와 같음)
+  uint rss;     // 실제로 쓴 물리 페이지 수 (getpp 와 같음)
+  uint lazy;    // 예약만 되고 아직 접근하지 않은 ssualloc 페이지 수
+  uint faults;  // 처리한 lazy 페이지 폴트 횟수
+  uint swapped; // 스왑 영역으로 나간 페이지 수
+};
@@ -20,13 +20,24 @@
 
 #define NINODES 200
 
+#ifdef HASHDIR
+// 루트 디렉토리를 해시 디렉토리로 만들 때의 버킷 블록 수 (fs.h 참고)
+// 버킷들을 메모리에서 채운 뒤 마지막에 한 번에 기록
+// 2 의 거듭제곱이어야 커널의 linear hashing (fs.c hbucket) 과 dirhash % NDIRBUCKET 가 같음
+#define NDIRBUCKET 256
+struct dirent rootdir[NDIRBUCKET*DPB];
+struct dirent roottail[NINODES];  // 버킷이 가득 차서 버킷들 뒤에 덧붙일 엔트리
+int nroottail;
+#endif
+
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
 int nlog = LOGSIZE;
-int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
+int nswap = SWAPPAGES * (4096 / BSIZE);  //스왑 영역 블록 수 (페이지 하나 = 블록 8개)
+int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap, swap)
 int nblocks;  // Number of data blocks
 
 int fsfd;
@@ -43,6 +54,10 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+uint ebmap(struct dinode *din, uint fbn);
+#ifdef HASHDIR
+void hdirappend(struct dirent *de);
+#endif
 
 // convert to intel byte order
 ushort
@@ -94,7 +109,7 @@ main(int argc, char *argv[])
   }
 
   // 1 fs block = 1 disk sector
-  nmeta = 2 + nlog + ninodeblocks + nbitmap;
+  nmeta = 2 + nlog + ninodeblocks + nbitmap + nswap;
   nblocks = FSSIZE - nmeta;
 
   sb.size = xint(FSSIZE);
@@ -104,9 +119,11 @@ main(int argc, char *argv[])
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.swapstart = xint(2+nlog+ninodeblocks+nbitmap);
+  sb.nswap = xint(nswap);
 
-  printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-         nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+  printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u, swap blocks %u) blocks %d total %d\n",
+         nmeta, nlog, ninodeblocks, nbitmap, nswap, nblocks, FSSIZE);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
@@ -120,6 +137,12 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
+#ifdef HASHDIR
+  //"." 와 ".." 는 블록 0 의 처음 두 칸
+  rootdir[0].inum = rootdir[1].inum = xshort(rootino);
+  strcpy(rootdir[0].name, ".");
+  strcpy(rootdir[1].name, "..");
+#else
   bzero(&de, sizeof(de));
   de.inum = xshort(rootino);
   strcpy(de.name, ".");
@@ -129,6 +152,7 @@ main(int argc, char *argv[])
   de.inum = xshort(rootino);
   strcpy(de.name, "..");
   iappend(rootino, &de, sizeof(de));
+#endif
 
   for(i = 2; i < argc; i++){
 #if JH
@@ -153,7 +177,11 @@ main(int argc, char *argv[])
     bzero(&de, sizeof(de));
     de.inum = xshort(inum);
     strncpy(de.name, argv[i], DIRSIZ);
+#ifdef HASHDIR
+    hdirappend(&de);
+#else
     iappend(rootino, &de, sizeof(de));
+#endif
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -161,18 +189,65 @@ main(int argc, char *argv[])
     close(fd);
   }
 
+#ifdef HASHDIR
+  //버킷 블록들과 넘친 엔트리를 기록하고 버킷 수를 minor 에
+  iappend(rootino, rootdir, sizeof(rootdir));
+  if(nroottail > 0)
+    iappend(rootino, roottail, nroottail*sizeof(struct dirent));
+  rinode(rootino, &din);
+  off = xint(din.size);
+  assert(off == NDIRBUCKET*BSIZE + nroottail*sizeof(struct dirent));
+  din.minor = xshort(NDIRBUCKET);
+  winode(rootino, &din);
+#else
   // fix size of root inode dir
   rinode(rootino, &din);
   off = xint(din.size);
   off = ((off/BSIZE) + 1) * BSIZE;
   din.size = xint(off);
   winode(rootino, &din);
+#endif
 
   balloc(freeblock);
 
   exit(0);
 }
 
+#ifdef HASHDIR
+// fs.c 의 dirhash 와 같아야 함
+uint
+dirhash(char *name)
+{
+  uint h = 0;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h;
+}
+
+// 루트 디렉토리의 해시 버킷에 엔트리 추가 (가득 차면 버킷들 뒤에 덧붙임, fs.h 참고)
+void
+hdirappend(struct dirent *de)
+{
+  uint j;
+  struct dirent *e;
+
+  e = &rootdir[(dirhash(de->name) % NDIRBUCKET)*DPB];
+  for(j = 0; j < DPB; j++){
+    if(e[j].inum == 0){
+      e[j] = *de;
+      return;
+    }
+  }
+  if(nroottail == NINODES){
+    fprintf(stderr, "mkfs: root directory full\n");
+    exit(1);
+  }
+  roottail[nroottail++] = *de;
+}
+#endif
+
 void
 wsect(uint sec, void *buf)
 {
@@ -235,6 +310,10 @@ ialloc(ushort type)
 
   bzero(&din, sizeof(din));
   din.type = xshort(type);
+#ifdef EXTENT
+  if(type == T_FILE)
+    din.major = xshort(IFMT_EXTENT); //일반 파일은 extent 방식으로 생성
+#endif
   din.nlink = xshort(1);
   din.size = xint(0);
   winode(inum, &din);
@@ -266,6 +345,58 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+//extent inode 에서 fbn 번째 블록 주소를 구해옴 (파일 끝 블록이면 freeblock 에서 할당)
+//mkfs 는 freeblock 을 차례로 쓰기 때문에 보통 파일 하나가 extent 하나로 끝남
+uint
+ebmap(struct dinode *din, uint fbn)
+{
+  struct extent ext[NEXTBLK];
+  struct extent *e, *prev = 0;
+  int i, n = NEXTENT, inblk = 0;
+  uint x;
+
+  e = (struct extent*)din->addrs;
+  for(i = 0; ; i++){
+    if(i == n){
+      assert(!inblk); //extent 블록까지 가득 참
+      if(xint(din->addrs[EXTBLK]) == 0){
+        e = 0;
+        break;
+      }
+      rsect(xint(din->addrs[EXTBLK]), (char*)ext);
+      e = ext;
+      n = NEXTBLK;
+      i = 0;
+      inblk = 1;
+    }
+    if(xint(e[i].len) == 0)
+      break;
+    if(fbn < xint(e[i].len))
+      return xint(e[i].start) + fbn;
+    fbn -= xint(e[i].len);
+    prev = &e[i];
+  }
+  assert(fbn == 0); //hole 은 없음
+
+  x = freeblock++;
+  if(prev && xint(prev->start) + xint(prev->len) == x){
+    prev->len = xint(xint(prev->len) + 1); //직전 extent 에 이어붙임
+  } else {
+    if(e == 0){ //extent 블록 새로 할당
+      din->addrs[EXTBLK] = xint(freeblock++);
+      bzero(ext, sizeof(ext));
+      e = ext;
+      i = 0;
+      inblk = 1;
+    }
+    e[i].start = xint(x);
+    e[i].len = xint(1);
+  }
+  if(inblk)
+    wsect(xint(din->addrs[EXTBLK]), (char*)ext);
+  return x;
+}
+
 //inode 초기화할 때 사용하는 것으로 추측중
 void
 iappend(uint inum, void *xp, int n)
@@ -296,8 +427,12 @@ iappend(uint inum, void *xp, int n)
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
 
+    //extent inode 는 (시작블록, 길이) 배열로 매핑
+    if(xshort(din.type) == T_FILE && xshort(din.major) == IFMT_EXTENT){
+      x = ebmap(&din, fbn);
+    }
     //직접 매핑할 때 호출되는 부분
-    if(fbn < NDIRECT){
+    else if(fbn < NDIRECT){
 #if JH
       printf("first NDIRECT : %d\n", fbn);
 #endif
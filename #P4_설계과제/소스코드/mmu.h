@@ -90,12 +90,24 @@ struct segdesc {
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
 
+// P4 : PDE 하나 (PTE_PS superpage) 가 매핑하는 4MB
+#define SPGSIZE         (PGSIZE*NPTENTRIES)
+#define SPGROUNDDOWN(a) (((a)) & ~(SPGSIZE-1))
+
 // Page table/directory entry flags.
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
 #define PTE_LAZY        0x008   // 페이지 테이블에 할당은 됐는데 trap호출 시 할당하는 것으로 변경
+#define PTE_A           0x020   // Accessed
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
+#define PTE_COW         0x200   // fork 후 부모/자식이 공유 중인 읽기 전용 페이지 (쓰기 폴트 때 복사)
+#define PTE_SHR         0x400   // MAP_SHARED 파일 매핑 페이지 (fork 해도 copy-on-write 하지 않고 같이 씀)
+#define PTE_SWAP        0x800   // PTE_P 가 없을 때 : 스왑 영역으로 나간 페이지 (주소 자리에 슬롯 번호, swap.c)
+
+// 페이지 폴트 에러코드 (tf->err)
+#define FEC_WR          0x002   // 쓰기 접근에서 발생한 폴트
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
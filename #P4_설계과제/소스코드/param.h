@@ -3,7 +3,7 @@
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE     2048  // maximum number of active i-nodes (P4 : iget 해시 + LRU)
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
@@ -12,4 +12,9 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 //#define FSSIZE       10000  // P4과제를 위한 Filesystem 파일크기 변경
 #define FSSIZE       2500000  // P4과제를 위한 Filesystem 파일크기 변경
+#define FAULTAROUND     64  // lazy 폴트 한 번에 미리 채울 수 있는 최대 페이지 수 (faultaround() 상한)
+#define NVMA            32  // 프로세스 하나가 가질 수 있는 ssualloc 구간 수
+#define SWAPPAGES    65536  // 스왑 영역 크기 (페이지, 256MB -> mkfs 가 SWAPPAGES*8 블록 예약)
+#define SWAPLOW         64  // 빈 물리 페이지가 이보다 적으면 kalloc 이 스왑 데몬을 깨움
+#define SWAPHIGH       256  // 스왑 데몬은 빈 물리 페이지가 이만큼 될 때까지 쫓아냄
 
@@ -0,0 +1,81 @@
+// Per-CPU state
+struct cpu {
+  uchar apicid;                // Local APIC ID
+  struct context *scheduler;   // swtch() here to enter scheduler
+  struct taskstate ts;         // Used by x86 to find stack for interrupt
+  struct segdesc gdt[NSEGS];   // x86 global descriptor table
+  volatile uint started;       // Has the CPU started?
+  int ncli;                    // Depth of pushcli nesting.
+  int intena;                  // Were interrupts enabled before pushcli?
+  struct proc *proc;           // The process running on this cpu or null
+};
+
+extern struct cpu cpus[NCPU];
+extern int ncpu;
+
+//PAGEBREAK: 17
+// Saved registers for kernel context switches.
+// Don't need to save all the segment registers (%cs, etc),
+// because they are constant across kernel contexts.
+// Don't need to save %eax, %ecx, %edx, because the
+// x86 convention is that the caller has saved them.
+// Contexts are stored at the bottom of the stack they
+// describe; the stack pointer is the address of the context.
+// The layout of the context matches the layout of the stack in swtch.S
+// at the "Switch stacks" comment. Switch doesn't save eip explicitly,
+// but it is on the stack and allocproc() manipulates it.
+struct context {
+  uint edi;
+  uint esi;
+  uint ebx;
+  uint ebp;
+  uint eip;
+};
+
+enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
+
+// P4 : ssualloc/mmap 으로 예약한 가상 주소 구간 [start, end) (vm.c vmaadd/vmaremove/vmalookup)
+struct vma {
+  uint start;
+  uint end;
+  struct file *f;              // mmap 한 파일 (ssualloc 구간이면 0)
+  uint off;                    // start 에 대응하는 파일 오프셋
+  uint filesz;                 // start 부터 파일에서 읽어올 바이트 수 (그 뒤는 0, exec 의 bss)
+  int flags;                   // MAP_WRITE, MAP_SHARED (fcntl.h)
+};
+
+// Per-process state
+struct proc {
+  uint sz;                     // Size of process memory (bytes)
+  pde_t* pgdir;                // Page table
+  char *kstack;                // Bottom of kernel stack for this process
+  enum procstate state;        // Process state
+  int pid;                     // Process ID
+  struct proc *parent;         // Parent process
+  struct trapframe *tf;        // Trap frame for current syscall
+  struct context *context;     // swtch() here to run process
+  void *chan;                  // If non-zero, sleeping on chan
+  int killed;                  // If non-zero, have been killed
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+  char name[16];               // Process name (debugging)
+  uint fa_max;                 // fault-around 최대 창 크기 (페이지 수, 1 이면 fault-around 안 함)
+  uint fa_win;                 // 현재 fault-around 창 크기 (순차 접근이면 fa_max 까지 두 배씩 증가)
+  int superok;                 // 1 이면 익명 구간의 쓰기 폴트를 superpage 로 매핑 (superpage() 로 켬, 기본은 0)
+  uint fa_next;                // 순차 접근이라면 다음 lazy 폴트가 날 주소
+  uint nfault;                 // 처리한 lazy 페이지 폴트 횟수
+  uint vpages;                 // 가상 페이지 수 (PTE_P 또는 PTE_LAZY 인 PTE, getvp)
+  uint rss;                    // 물리 페이지 수 (zero page 를 제외한 PTE_P 인 PTE, getpp)
+  uint nlazy;                  // 예약만 되고 아직 폴트가 나지 않은 PTE_LAZY 페이지 수
+  uint nswap;                  // 스왑 영역으로 나간 페이지 수 (PTE_SWAP)
+  uint pinlo, pinhi;           // 커널이 lock 을 잡고 쓸 사용자 버퍼 (vm.c pinuvm), 스왑으로 내보내지 않음
+  int upreempt;                // 사용자 모드에서 타이머로 선점되어 RUNNABLE 인 중 (이때만 다른 프로세스가 페이지를 쫓아낼 수 있음)
+  struct vma vma[NVMA];        // ssualloc/mmap 구간 (start 오름차순)
+  int nvma;                    // vma[] 에서 쓰는 개수
+};
+
+// Process memory is laid out contiguously, low addresses first:
+//   text
+//   original data and bss
+//   fixed-size stack
+//   expandable heap
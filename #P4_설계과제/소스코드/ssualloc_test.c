@@ -2,51 +2,286 @@
 #include "stat.h"
 #include "user.h"
 #include "fcntl.h"
+#include "memstat.h"
+
+#define SWEEP_PAGES 256
+#define COW_PAGES 8
+#define SWAP_CHUNK 256      // 스왑 검사에서 한 번에 ssualloc 하는 페이지 수 (1MB)
+#define SWAP_MAXCHUNK 400   // 물리 메모리 + 스왑 영역 (256MB) 안에서 멈추도록 최대 400MB
+
+int nfail;
+int swapchunk[SWAP_MAXCHUNK];
+
+/**
+ * 검사 결과 출력 : ok 가 참이면 "ok", 아니면 "FAIL" 을 출력하고 실패 개수를 셈 (main 끝에서 출력)
+*/
+void check(int ok, const char *what)
+{
+	printf(1, "%s: %s\n", what, ok ? "ok" : "FAIL");
+	if (!ok)
+		nfail++;
+}
+
+/**
+ * SWEEP_PAGES 개의 가상 페이지를 할당받아 앞에서부터 차례로 한 바이트씩 써보고
+ * 그동안 늘어난 lazy 페이지 폴트 수와 물리 페이지 수를 출력
+ * @param window : faultaround() 창 크기 (1 이면 fault-around 안 함)
+*/
+void faultaround_test(int window)
+{
+	int i, faults, pages;
+	char *addr;
+
+	faultaround(window);
+	addr = (char *) ssualloc(SWEEP_PAGES * 4096);
+	if ((int) addr <= 0) {
+		printf(1, "ssualloc(): failed...\n");
+		return;
+	}
+	faults = faultaround(0);
+	pages = getpp();
+	for (i = 0; i < SWEEP_PAGES; i++)
+		addr[i * 4096] = 'x';
+	faults = faultaround(0) - faults;
+	pages = getpp() - pages;
+	printf(1, "fault-around %d: sequential access of %d pages: page faults: %d, physical pages added: %d\n",
+			window, SWEEP_PAGES, faults, pages);
+	check(pages == SWEEP_PAGES && (window == 1 ? faults == SWEEP_PAGES : faults < SWEEP_PAGES),
+			window == 1 ? "fault-around off" : "fault-around on");
+	faultaround(1);
+}
+
+/**
+ * superpage 검사 : 8MB 를 예약하면 그 안에 4MB 경계에 맞춘 4MB 구간이 하나는 생김
+ * superpage 는 기본으로 꺼져 있어서 그 구간에 한 번 쓰면 물리 페이지가 하나만 늘어야 하고
+ * superpage(1) 로 켜면 폴트 한 번에 1024 개가 늘어야 함 (연속된 물리 메모리가 없으면 4KB 페이지 하나만 늘어남)
+ * 가운데 한 페이지를 ssufree 하면 4KB 페이지로 쪼개져서 나머지 내용은 그대로여야 함
+*/
+void superpage_test(void)
+{
+	int i, pages, bad = 0;
+	char *addr, *big;
+
+	addr = (char *) ssualloc(2048 * 4096);
+	if ((int) addr <= 0) {
+		printf(1, "ssualloc(): failed...\n");
+		return;
+	}
+	big = (char *) (((uint) addr + 0x3FFFFF) & ~0x3FFFFF);
+	pages = getpp();
+	big[0] = 's';
+	pages = getpp() - pages;
+	printf(1, "superpage: off, physical pages added by one write: %d\n", pages);
+	check(pages == 1, "superpage off by default");
+	ssufree(addr, 2048 * 4096);
+	superpage(1);
+
+	addr = (char *) ssualloc(2048 * 4096);
+	if ((int) addr <= 0) {
+		printf(1, "ssualloc(): failed...\n");
+		return;
+	}
+	big = (char *) (((uint) addr + 0x3FFFFF) & ~0x3FFFFF);
+	pages = getpp();
+	big[0] = 's';
+	pages = getpp() - pages;
+	printf(1, "superpage: physical pages added by one write: %d\n", pages);
+	//연속된 물리 메모리가 없으면 4KB 페이지로 처리되므로 1 도 맞음
+	check(pages == 1024 || pages == 1, "superpage on");
+	for (i = 0; i < 1024; i++)
+		big[i * 4096] = i;
+	if (ssufree(big + 512 * 4096, 4096) < 0)
+		printf(1, "ssufree(): failed...\n");
+	for (i = 0; i < 1024; i++)
+		if (i != 512 && big[i * 4096] != (char) i)
+			bad++;
+	printf(1, "superpage: after splitting free: bad pages: %d\n", bad);
+	check(bad == 0, "superpage split");
+	ssufree(addr, big + 512 * 4096 - addr);
+	ssufree(big + 513 * 4096, addr + 2048 * 4096 - (big + 513 * 4096));
+	superpage(0);
+}
+
+/**
+ * mmap 검사 : 파일을 읽기 전용으로 매핑해서 read() 없이 내용을 확인하고
+ * MAP_SHARED|MAP_WRITE 로 매핑해서 쓴 내용이 ssufree(munmap) 후 파일에 남는지 확인
+*/
+void mmap_test(void)
+{
+	int fd, i, bad = 0;
+	char buf[512], *addr;
+
+	fd = open("mmapfile", O_CREATE | O_RDWR);
+	for (i = 0; i < 512; i++)
+		buf[i] = 'a' + i % 26;
+	for (i = 0; i < 20; i++) //10KB (페이지 3개에 걸침)
+		write(fd, buf, 512);
+	close(fd);
+
+	fd = open("mmapfile", O_RDONLY);
+	addr = mmap(fd, 0, 20 * 512, 0);
+	close(fd); //fd 를 닫아도 매핑은 유지됨
+	if ((int) addr < 0) {
+		printf(1, "mmap(): failed...\n");
+		return;
+	}
+	for (i = 0; i < 20 * 512; i++)
+		if (addr[i] != 'a' + i % 512 % 26)
+			bad++;
+	printf(1, "mmap read-only: %d bytes differ, physical pages: %d\n", bad, getpp());
+	check(bad == 0, "mmap read-only");
+	ssufree(addr, 3 * 4096);
+
+	fd = open("mmapfile", O_RDWR);
+	addr = mmap(fd, 4096, 4096, MAP_WRITE | MAP_SHARED);
+	if ((int) addr < 0) {
+		printf(1, "mmap(): failed...\n");
+		close(fd);
+		return;
+	}
+	addr[0] = '#';
+	ssufree(addr, 4096); //수정된 페이지를 파일에 씀
+	for (i = 0; i <= 4096 / 512; i++) //마지막으로 읽은 것이 오프셋 4096 블록
+		read(fd, buf, 512);
+	printf(1, "mmap shared write: file offset 4096 is '%c'\n", buf[0]);
+	check(buf[0] == '#', "mmap shared write");
+	close(fd);
+	unlink("mmapfile");
+}
+
+/**
+ * copy-on-write 검사 : fork 한 뒤 자식이 쓴 내용은 부모에게, 부모가 쓴 내용은 자식에게 보이지 않아야 함
+ * 자식은 짝수 페이지에, 부모는 홀수 페이지에 씀. 자식의 검사 결과는 pipe 로 받음 (exit 에는 상태값이 없음)
+*/
+void cow_test(void)
+{
+	int i, pid, tochild[2], toparent[2], bad = 0;
+	char *addr, r1 = 0, r2 = 0, go = 'g';
+
+	addr = (char *) ssualloc(COW_PAGES * 4096);
+	if ((int) addr <= 0) {
+		printf(1, "ssualloc(): failed...\n");
+		nfail++;
+		return;
+	}
+	for (i = 0; i < COW_PAGES; i++)
+		addr[i * 4096] = 'p';
+	if (pipe(tochild) < 0 || pipe(toparent) < 0) {
+		printf(1, "pipe(): failed...\n");
+		nfail++;
+		return;
+	}
+	if ((pid = fork()) < 0) {
+		printf(1, "fork(): failed...\n");
+		nfail++;
+		return;
+	}
+	if (pid == 0) {
+		for (i = 0; i < COW_PAGES; i++)
+			if (addr[i * 4096] != 'p')
+				bad++;
+		for (i = 0; i < COW_PAGES; i += 2)
+			addr[i * 4096] = 'c';
+		r1 = bad == 0 ? 'y' : 'n';
+		write(toparent[1], &r1, 1);
+		read(tochild[0], &go, 1);  //부모가 홀수 페이지에 쓸 때까지 기다림
+		for (i = 0; i < COW_PAGES; i++)
+			if (addr[i * 4096] != (i % 2 == 0 ? 'c' : 'p'))
+				bad++;
+		r2 = bad == 0 ? 'y' : 'n';
+		write(toparent[1], &r2, 1);
+		exit();
+	}
+	read(toparent[0], &r1, 1);
+	for (i = 0; i < COW_PAGES; i++)
+		if (addr[i * 4096] != 'p')
+			bad++;
+	for (i = 1; i < COW_PAGES; i += 2)
+		addr[i * 4096] = 'q';
+	write(tochild[1], &go, 1);
+	read(toparent[0], &r2, 1);
+	wait();
+	for (i = 0; i < COW_PAGES; i++)
+		if (addr[i * 4096] != (i % 2 == 0 ? 'p' : 'q'))
+			bad++;
+	check(r1 == 'y', "cow: child sees parent's pages after fork");
+	check(r2 == 'y', "cow: parent's writes stay out of child");
+	check(bad == 0, "cow: child's writes stay out of parent");
+	close(tochild[0]);
+	close(tochild[1]);
+	close(toparent[0]);
+	close(toparent[1]);
+	ssufree(addr, COW_PAGES * 4096);
+}
+
+/**
+ * 스왑 검사 : 스왑으로 페이지가 나갈 때까지 1MB 씩 ssualloc 해서 페이지마다 번호를 쓰고
+ * 스왑이 SWAP_CHUNK 페이지 이상 나간 뒤 모든 페이지를 다시 읽어서 번호가 그대로인지 확인 (swap-out -> swap-in)
+*/
+void swap_test(void)
+{
+	int c, i, n, bad = 0;
+	struct memstat ms;
+
+	ms.swapped = 0;
+	for (n = 0; n < SWAP_MAXCHUNK && ms.swapped < SWAP_CHUNK; n++) {
+		if ((swapchunk[n] = ssualloc(SWAP_CHUNK * 4096)) < 0)
+			break;
+		for (i = 0; i < SWAP_CHUNK; i++)
+			*(int *) (swapchunk[n] + i * 4096) = n * SWAP_CHUNK + i;
+		memstat(&ms);
+	}
+	printf(1, "swap: wrote %d pages, swapped pages: %d\n", n * SWAP_CHUNK, ms.swapped);
+	check(ms.swapped >= SWAP_CHUNK, "swap: pages swapped out");
+	for (c = 0; c < n; c++)
+		for (i = 0; i < SWAP_CHUNK; i++)
+			if (*(int *) (swapchunk[c] + i * 4096) != c * SWAP_CHUNK + i)
+				bad++;
+	check(bad == 0, "swap: contents after swap-in");
+	for (c = 0; c < n; c++)
+		ssufree((void *) swapchunk[c], SWAP_CHUNK * 4096);
+}
 
 int main(void)
 {
-	int ret;
+	int ret, vp, pp;
 	//가상메모리 검사 (물리메모리페이지와 가상메모리 체크)
 	printf(1, "Start: memory usages: virtual pages: %d, physical pages: %d\n", getvp(), getpp()); 
 	//가상메모리 할당 시도 -> 음수라서 에러처리
-	ret = ssualloc(-1234);
-
-	if(ret < 0) 
-		printf(1, "ssualloc() usage: argument wrong...\n");
-	else
-		exit();
-
+	check(ssualloc(-1234) < 0, "ssualloc() rejects negative size");
 	//가상메모리 할당 시도 -> 페이지크기 배수가 아니라서 에러처리
-	ret = ssualloc(1234);
-
-	if(ret < 0)
-		printf(1, "ssualloc() usage: argument wrong...\n");
-	else
-		exit();
+	check(ssualloc(1234) < 0, "ssualloc() rejects size not a multiple of 4096");
 
 	//가상메모리에만 페이지 1개 추가
+	vp = getvp();
+	pp = getpp();
 	ret = ssualloc(4096);
 
 	if(ret < 0 )
-		printf(1, "ssualloc(): failed...\n");
+		check(0, "ssualloc() one page");
 	else {
 		//가상메모리 만 1개추가 (물리메모리는 추가되면 안됨)
 		printf(1, "After allocate one virtual page: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(getvp() == vp + 1 && getpp() == pp, "ssualloc() reserves without physical memory");
 		char *addr = (char *) ret;
 
 		//해당페이지 접근 후 물리메모리가 추가되는지 검사
 		addr[0] = 'I';
 		printf(1, "After access one virtual page: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(getvp() == vp + 1 && getpp() == pp + 1, "first access adds one physical page");
 	}
 
 	//가상메모리 할당 : 페이지 3개 추가
+	vp = getvp();
+	pp = getpp();
 	ret = ssualloc(12288);
 
 	if(ret < 0 )
-		printf(1, "ssualloc(): failed...\n");
+		check(0, "ssualloc() three pages");
 	else {
 		//가상메모리만 3개 추가되야함
 		printf(1, "After allocate three virtual pages: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(getvp() == vp + 3 && getpp() == pp, "ssualloc() three pages");
 		char *addr = (char *) ret;
 
 		//각 페이지마다 하나씩 추가되면서 물리메모리 개수가 1개씩 증가하는지 확인
@@ -56,7 +291,92 @@ int main(void)
 		printf(1, "After access of third virtual page: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
 		addr[8000] = 'c';
 		printf(1, "After access of second virtual page: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(getpp() == pp + 3 && addr[0] == 'a' && addr[10000] == 'b' && addr[8000] == 'c',
+				"each accessed page adds one physical page");
+	}
+
+	//가상메모리 할당 : 페이지 2개 추가 후 읽기만 하면 공유 zero page 가 매핑되어 물리메모리는 늘지 않아야 함
+	pp = getpp();
+	ret = ssualloc(8192);
+
+	if(ret < 0 )
+		check(0, "ssualloc() two pages");
+	else {
+		char *addr = (char *) ret;
+
+		printf(1, "After read of two virtual pages (%d): virtual pages: %d, physical pages: %d\n", addr[0] + addr[4096], getvp(), getpp());
+		check(addr[0] == 0 && addr[4096] == 0 && getpp() == pp, "read fault maps the zero page");
+		//쓰는 순간 그 페이지만 물리메모리가 1개 추가되어야 함
+		addr[4096] = 'z';
+		printf(1, "After write of second virtual page: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(addr[0] == 0 && addr[4096] == 'z' && getpp() == pp + 1, "write after read copies the zero page");
+	}
+
+	//fault-around 검사 : 같은 크기(256 페이지)를 순차로 한 번씩 접근할 때 폴트 횟수 비교
+	faultaround_test(1);
+	faultaround_test(16);
+	superpage_test();
+
+	//ssufree 검사 : 페이지 4개를 모두 쓴 뒤 가운데 2개를 돌려주면 물리/가상 페이지가 2개씩 줄어야 함
+	ret = ssualloc(4 * 4096);
+
+	if(ret < 0 )
+		check(0, "ssualloc() four pages");
+	else {
+		char *addr = (char *) ret;
+
+		addr[0] = addr[4096] = addr[8192] = addr[12288] = 'f';
+		printf(1, "After write of four virtual pages: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		vp = getvp();
+		pp = getpp();
+		check(ssufree(addr + 4096, 8192) == 0, "ssufree() two middle pages");
+		printf(1, "After free of two middle pages: virtual pages: %d, physical pages: %d\n", getvp(), getpp());
+		check(getvp() == vp - 2 && getpp() == pp - 2 && addr[0] == 'f' && addr[12288] == 'f',
+				"ssufree() returns virtual and physical pages");
+		//이미 돌려준 구멍을 다시 돌려주면 에러
+		check(ssufree(addr + 4096, 4096) < 0, "ssufree() rejects a freed hole");
 	}
 
+	//lazy sbrk 검사 : 힙을 64 페이지 늘려도 물리 페이지는 그대로, 한 페이지에 쓰면 1개만 늘고 줄이면 원래대로
+	{
+		char *heap;
+
+		vp = getvp();
+		pp = getpp();
+		heap = sbrk(64 * 4096);
+		if (heap == (char *) -1)
+			check(0, "sbrk() 64 pages");
+		else {
+			printf(1, "After sbrk of 64 pages: virtual pages added: %d, physical pages added: %d\n", getvp() - vp, getpp() - pp);
+			check(getvp() - vp == 64 && getpp() == pp, "lazy sbrk");
+			heap[10 * 4096] = 'h';
+			printf(1, "After write of one heap page: physical pages added: %d\n", getpp() - pp);
+			check(getpp() - pp == 1, "heap write adds one physical page");
+			sbrk(-64 * 4096);
+			printf(1, "After sbrk shrink: virtual pages added: %d, physical pages added: %d\n", getvp() - vp, getpp() - pp);
+			check(getvp() == vp && getpp() == pp, "sbrk shrink");
+		}
+	}
+
+	mmap_test();
+	cow_test();
+
+	//memstat 검사 : getvp/getpp 와 같은 값 + 아직 접근하지 않은 페이지 수 + 폴트 횟수
+	struct memstat ms;
+	ssualloc(4 * 4096);
+	if (memstat(&ms) < 0)
+		check(0, "memstat()");
+	else {
+		printf(1, "memstat: virtual pages: %d (getvp %d), physical pages: %d (getpp %d), lazy pages: %d, page faults: %d, swapped pages: %d\n",
+				ms.vpages, getvp(), ms.rss, getpp(), ms.lazy, ms.faults, ms.swapped);
+		check(ms.vpages == getvp() && ms.rss == getpp() && ms.lazy >= 4, "memstat");
+	}
+
+	swap_test();
+
+	if (nfail)
+		printf(1, "ssualloc_test: %d checks failed\n", nfail);
+	else
+		printf(1, "ssualloc_test: all checks passed\n");
 	exit();
 }
@@ -2,8 +2,10 @@
 #include "stat.h"
 #include "user.h"
 #include "fcntl.h"
+#include "fs.h"
 
-#define BSIZE 512
+#define NIFILE 200     // extent 검사 : 두 파일에 번갈아 쓰는 블록 수
+#define NDIRENT 400    // 디렉토리 검사 : 한 디렉토리에 만드는 이름 수 (link 라서 inode 는 하나)
 
 char buf[BSIZE];
 
@@ -17,6 +19,24 @@ void _success() {
 	printf(1, "ok\n");
 }
 
+// i 번째 블록에 쓸 내용 : 블록 번호 + 파일마다 다른 문자
+void fill(int i, char c) {
+	memset(buf, c, BSIZE);
+	*(int *) buf = i;
+}
+
+// buf 가 fill(i, c) 로 쓴 내용인지
+int same(int i, char c) {
+	int j;
+
+	if (*(int *) buf != i)
+		return 0;
+	for (j = sizeof(int); j < BSIZE; j++)
+		if (buf[j] != c)
+			return 0;
+	return 1;
+}
+
 void test(int ntest, int blocks) {
 	char filename[16] = "file";
 	int fd, i, ret = 0;
@@ -33,10 +53,11 @@ void test(int ntest, int blocks) {
 
 	//파일 생성을 위해 블록수만큼 write 시도 (실질적 파일 검사) -> bmap 검사
 	for (i = 0; i < blocks; i++) {
+		fill(i, 'a' + ntest);
 		ret = write(fd, buf, BSIZE);
-		if (ret < 0) break;
+		if (ret != BSIZE) break;
 	}
-	if (ret < 0)
+	if (ret != BSIZE)
 		_error("File write error\n");
 	else
 		_success(); //파일 성공여부 출력
@@ -56,13 +77,15 @@ void test(int ntest, int blocks) {
 	if (fd < 0)
 		_error("File open error\n");
 
-	//블록수만큼 파일 읽기 검사  -> 기본적으로 bmap함수랑 동일한 메커니즘
+	//블록수만큼 파일 읽기 검사  -> 기본적으로 bmap함수랑 동일한 메커니즘, 쓴 내용 그대로인지 확인
 	for (i = 0; i < blocks; i++) {
 		ret = read(fd, buf, BSIZE);
-		if (ret < 0) break;
+		if (ret != BSIZE || !same(i, 'a' + ntest)) break;
 	}
-	if (ret < 0)
+	if (ret != BSIZE)
 		_error("File read error\n");
+	if (i < blocks)
+		_error("File data mismatch\n");
 
 	//파일 닫기 시도	
 	if (close(fd) < 0)
@@ -81,22 +104,191 @@ void test(int ntest, int blocks) {
 	fd = open(filename, O_RDONLY);
 	//파일이 지워졌는데 남아있는지 검사 : unlink 검사	
 	if (fd < 0) 
-		printf(1, "failed\n");
+		_success();
 	else
-		printf(1, "this statement cannot be runned\n");
+		_error("unlinked file still opens\n");
 
 	printf(1, "### test%d passed...\n\n", ntest);
 }
 
-int main(int argc, char **argv)
-{
-	for (int i = 0 ; i < BSIZE; i++) {
-		buf[i] = BSIZE % 10;
+/**
+ * 두 파일에 블록을 하나씩 번갈아 쓰면 디스크상 연속되지 않은 조각이 많이 생김
+ * (extent 방식이면 extent 가 inode 밖의 extent 블록까지 넘침) -> 두 파일 모두 내용이 그대로인지 확인
+*/
+void interleave_test(void) {
+	int fa, fb, i;
+
+	printf(1, "### interleave test start\n");
+	printf(1, "write two files block by block...\t");
+	fa = open("ifilea", O_CREATE | O_WRONLY);
+	fb = open("ifileb", O_CREATE | O_WRONLY);
+	if (fa < 0 || fb < 0)
+		_error("File open error\n");
+	for (i = 0; i < NIFILE; i++) {
+		fill(i, 'A');
+		if (write(fa, buf, BSIZE) != BSIZE)
+			_error("File write error\n");
+		fill(i, 'B');
+		if (write(fb, buf, BSIZE) != BSIZE)
+			_error("File write error\n");
 	}
+	close(fa);
+	close(fb);
+	_success();
 
+	printf(1, "read both files back...\t\t");
+	fa = open("ifilea", O_RDONLY);
+	fb = open("ifileb", O_RDONLY);
+	if (fa < 0 || fb < 0)
+		_error("File open error\n");
+	for (i = 0; i < NIFILE; i++) {
+		if (read(fa, buf, BSIZE) != BSIZE || !same(i, 'A'))
+			_error("File data mismatch\n");
+		if (read(fb, buf, BSIZE) != BSIZE || !same(i, 'B'))
+			_error("File data mismatch\n");
+	}
+	close(fa);
+	close(fb);
+	_success();
+
+	printf(1, "unlink both files...\t\t");
+	if (unlink("ifilea") < 0 || unlink("ifileb") < 0)
+		_error("File unlink error\n");
+	_success();
+	printf(1, "### interleave test passed...\n\n");
+}
+
+// 디렉토리 검사용 이름 : "n" + 세 자리 숫자
+void dname(char *name, int i) {
+	name[0] = 'n';
+	name[1] = '0' + i / 100 % 10;
+	name[2] = '0' + i / 10 % 10;
+	name[3] = '0' + i % 10;
+	name[4] = 0;
+}
+
+/**
+ * 한 디렉토리에 이름을 NDIRENT 개 만들고 (해시 디렉토리면 버킷이 여러 번 나뉨)
+ * 모든 이름이 찾아지는지, 반을 지운 뒤 지운 이름만 없어졌는지 확인
+*/
+void dir_test(void) {
+	char name[8];
+	int fd, i;
+
+	printf(1, "### directory test start\n");
+	printf(1, "create %d names in one directory...\t", NDIRENT);
+	if (mkdir("dtest") < 0 || chdir("dtest") < 0)
+		_error("mkdir error\n");
+	fd = open("target", O_CREATE | O_WRONLY);
+	if (fd < 0)
+		_error("File open error\n");
+	close(fd);
+	for (i = 0; i < NDIRENT; i++) {
+		dname(name, i);
+		if (link("target", name) < 0)
+			_error("link error\n");
+	}
+	_success();
+
+	printf(1, "look up every name...\t\t");
+	for (i = 0; i < NDIRENT; i++) {
+		dname(name, i);
+		if ((fd = open(name, O_RDONLY)) < 0)
+			_error("lookup error\n");
+		close(fd);
+	}
+	_success();
+
+	printf(1, "unlink even names...\t\t");
+	for (i = 0; i < NDIRENT; i += 2) {
+		dname(name, i);
+		if (unlink(name) < 0)
+			_error("File unlink error\n");
+	}
+	for (i = 0; i < NDIRENT; i++) {
+		dname(name, i);
+		fd = open(name, O_RDONLY);
+		if ((fd >= 0) != (i % 2 == 1))
+			_error("lookup after unlink error\n");
+		if (fd >= 0)
+			close(fd);
+	}
+	_success();
+
+	printf(1, "remove directory...\t\t");
+	for (i = 1; i < NDIRENT; i += 2) {
+		dname(name, i);
+		if (unlink(name) < 0)
+			_error("File unlink error\n");
+	}
+	if (unlink("target") < 0 || chdir("..") < 0 || unlink("dtest") < 0)
+		_error("rmdir error\n");
+	_success();
+	printf(1, "### directory test passed...\n\n");
+}
+
+/**
+ * 지운 디렉토리의 inode 를 새 디렉토리가 다시 받아도 예전 이름 캐시 (dcache) 를 보지 않아야 함
+ * (mkdir d; cd d; ls; cd ..; rm d; mkdir e 에서 "create dots" panic 이 나던 경우)
+*/
+void dcache_test(void) {
+	struct dirent de;
+	int fd, i, n;
+
+	printf(1, "### dcache test start\n");
+	printf(1, "mkdir, list, rmdir, mkdir again...\t");
+	for (i = 0; i < 3; i++) {
+		if (mkdir("dcd") < 0 || chdir("dcd") < 0)
+			_error("mkdir error\n");
+		if ((fd = open(".", O_RDONLY)) < 0)
+			_error("File open error\n");
+		n = 0;
+		while (read(fd, &de, sizeof(de)) == sizeof(de))
+			if (de.inum != 0)
+				n++;
+		close(fd);
+		if (n != 2)  //"." 과 ".." 만 있어야 함
+			_error("directory listing error\n");
+		if (chdir("..") < 0 || unlink("dcd") < 0)
+			_error("rmdir error\n");
+		if (mkdir("dce") < 0 || chdir("dce") < 0)
+			_error("mkdir after rmdir error\n");
+		if ((fd = open("f", O_CREATE | O_WRONLY)) < 0)
+			_error("File open error\n");
+		close(fd);
+		if (unlink("f") < 0 || chdir("..") < 0 || unlink("dce") < 0)
+			_error("rmdir error\n");
+	}
+	_success();
+	printf(1, "### dcache test passed...\n\n");
+}
+
+/**
+ * 실행 중인 프로그램 파일은 쓰기용으로 열 수 없어야 함 (코드 페이지를 파일에서 지연 적재)
+*/
+void textbusy_test(char *path) {
+	int fd;
+
+	printf(1, "### running binary test start\n");
+	printf(1, "open %s for writing...\t", path);
+	if ((fd = open(path, O_WRONLY)) >= 0) {
+		close(fd);
+		_error("running binary opened for writing\n");
+	}
+	_success();
+	printf(1, "### running binary test passed...\n\n");
+}
+
+int main(int argc, char **argv)
+{
 	test(1, 5); //5번 직접블록검사
 	test(2, 500); //6,7,8번 등 2-level 파일 시스템 검사
 	test(3, 5000); //10,11 번 3-Level 파일 시스템 검사
 	test(4, 50000);	 //12번까지 Write(시간 엄청걸림) : 4-Level 파일 시스템 검사
+	interleave_test();
+	dir_test();
+	dcache_test();
+	textbusy_test(argv[0]);
+	printf(1, "ssufs_test: all tests passed\n");
 	exit();
 }
@@ -0,0 +1,180 @@
+// P4 : 스왑 영역 관리
+// mkfs 가 sb.swapstart 부터 sb.nswap 블록을 스왑 영역으로 예약해 둠
+// 페이지 하나 = 슬롯 하나 = 연속된 블록 SPB 개
+// 스왑으로 나간 페이지의 PTE 는 PTE_P 없이 PTE_SWAP | (슬롯 번호 << 12) | 원래 PTE_W/PTE_U/PTE_COW
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+#define SPB         (PGSIZE / BSIZE)            // 슬롯 하나의 블록 수
+#define SWAPSLOT(pte)  (PTE_ADDR(pte) >> PTXSHIFT)
+
+struct {
+  struct spinlock lock;       // ref[], hint 보호 (wait 가 ptable.lock 을 잡은 채 freevm -> swapfree 로 잡음)
+  struct spinlock waitlock;   // 스왑 데몬이 잠들 때 쓰는 lock (sleep 이 ptable.lock 을 잡으므로 lock 과 따로 둠)
+  struct sleeplock io;        // 스왑 아웃/인 직렬화 (쓰는 중인 슬롯을 먼저 읽지 않도록)
+  int ready;                  // swapinit 이 끝났는지
+  uint dev;
+  uint start;                 // 첫 슬롯의 블록 번호
+  uint nslot;
+  uint hint;                  // 다음에 빈 슬롯을 찾기 시작할 위치
+  ushort ref[SWAPPAGES];      // 슬롯을 가리키는 PTE 수 (fork 로 공유), 0 이면 빈 슬롯
+} swap;
+
+// 파일 시스템이 준비된 뒤 (forkret) 슈퍼블록에서 스왑 영역 위치를 읽음
+void
+swapinit(int dev)
+{
+  struct superblock sb;
+
+  initlock(&swap.lock, "swap");
+  initlock(&swap.waitlock, "swapwait");
+  initsleeplock(&swap.io, "swapio");
+  readsb(dev, &sb);
+  swap.dev = dev;
+  swap.start = sb.swapstart;
+  swap.nslot = sb.nswap / SPB;
+  if(swap.nslot > SWAPPAGES)
+    swap.nslot = SWAPPAGES;
+  swap.ready = 1;
+  cprintf("swap: start %d slots %d\n", swap.start, swap.nslot);
+}
+
+// 빈 슬롯 하나를 잡아 ref 1 로 만듦, 없으면 -1
+static int
+slotalloc(void)
+{
+  uint i, s;
+
+  acquire(&swap.lock);
+  for(i = 0; i < swap.nslot; i++){
+    s = (swap.hint + i) % swap.nslot;
+    if(swap.ref[s] == 0){
+      swap.ref[s] = 1;
+      swap.hint = s + 1;
+      release(&swap.lock);
+      return s;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// 스왑 PTE 하나가 늘어남 (copyuvm)
+void
+swapdup(uint pte)
+{
+  acquire(&swap.lock);
+  if(swap.ref[SWAPSLOT(pte)] == 0 || swap.ref[SWAPSLOT(pte)] == 0xFFFF)
+    panic("swapdup");
+  swap.ref[SWAPSLOT(pte)]++;
+  release(&swap.lock);
+}
+
+// 스왑 PTE 하나가 없어짐 (deallocuvm, swapin), 마지막이면 슬롯이 비게 됨
+void
+swapfree(uint pte)
+{
+  acquire(&swap.lock);
+  if(swap.ref[SWAPSLOT(pte)] == 0)
+    panic("swapfree");
+  swap.ref[SWAPSLOT(pte)]--;
+  release(&swap.lock);
+}
+
+// 페이지 하나를 골라 (proc.c pageout) 스왑 영역에 쓰고 물리 페이지를 돌려줌
+// skipva : 현재 프로세스에서 쫓아내면 안 되는 페이지 (지금 폴트를 처리 중인 페이지)
+// 성공 0, 스왑 영역이 가득 찼거나 쫓아낼 페이지가 없으면 -1
+int
+swapout(uint skipva)
+{
+  int slot, i;
+  char *pa;
+  struct buf *b;
+
+  if(!swap.ready)
+    return -1;
+  acquiresleep(&swap.io);
+  if((slot = slotalloc()) < 0){
+    releasesleep(&swap.io);
+    return -1;
+  }
+  if((pa = pageout(skipva, (slot << PTXSHIFT) | PTE_SWAP)) == 0){
+    swapfree(slot << PTXSHIFT);
+    releasesleep(&swap.io);
+    return -1;
+  }
+  //PTE 는 이미 스왑 항목으로 바뀌었으므로 그 사이 폴트가 나도 swap.io 를 기다렸다가 읽음
+  for(i = 0; i < SPB; i++){
+    b = getblk(swap.dev, swap.start + slot*SPB + i);
+    memmove(b->data, pa + i*BSIZE, BSIZE);
+    bwrite(b);
+    brelse(b);
+  }
+  kfree(pa);
+  releasesleep(&swap.io);
+  return 0;
+}
+
+// kalloc 이 실패하면 다른 페이지를 스왑으로 내보내고 다시 시도 (폴트 처리 경로에서 사용)
+char*
+swapalloc(uint skipva)
+{
+  char *mem;
+
+  while((mem = kalloc()) == 0)
+    if(swapout(skipva) < 0)
+      return 0;
+  return mem;
+}
+
+// 현재 프로세스의 스왑 PTE (va 페이지) 를 다시 물리 페이지로 읽어옴, 메모리가 없으면 -1
+int
+swapin(pte_t *pte, uint va)
+{
+  char *mem;
+  uint old;
+  int i;
+  struct buf *b;
+
+  if((mem = swapalloc(va)) == 0)
+    return -1;
+  acquiresleep(&swap.io);  //이 슬롯을 쓰는 중이면 다 쓸 때까지 기다림
+  old = *pte;
+  for(i = 0; i < SPB; i++){
+    b = bread(swap.dev, swap.start + SWAPSLOT(old)*SPB + i);
+    memmove(mem + i*BSIZE, b->data, BSIZE);
+    brelse(b);
+  }
+  *pte = V2P(mem) | PTE_P | (PTE_FLAGS(old) & (PTE_W|PTE_U|PTE_COW));  //없던 PTE 이므로 TLB flush 불필요
+  releasesleep(&swap.io);
+  swapfree(old);
+  myproc()->rss++;
+  myproc()->nswap--;
+  return 0;
+}
+
+// 스왑 데몬 (proc.c swapd) : kalloc 이 빈 페이지가 SWAPLOW 보다 적다고 깨울 때까지 잠
+void
+swapwait(void)
+{
+  acquire(&swap.waitlock);
+  sleep(&swap, &swap.waitlock);
+  release(&swap.waitlock);
+}
+
+// kalloc 에서 빈 페이지가 SWAPLOW 보다 적어지면 부름
+void
+swapwake(void)
+{
+  if(swap.ready)
+    wakeup(&swap);
+}
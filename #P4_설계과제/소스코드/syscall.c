@@ -19,7 +19,7 @@ fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if(addr >= curproc->sz || addr+4 > curproc->sz || uvmcheck(addr, 4) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -39,6 +39,9 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    //P4 : 새 페이지로 넘어갈 때마다 ssufree 로 뚫린 구멍이 아닌지 확인 (vm.c uvmcheck)
+    if((s == *pp || ((uint)s % PGSIZE) == 0) && uvmcheck((uint)s, 1) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -65,6 +68,8 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  if(uvmcheck((uint)i, size) < 0)  //P4 : sz 안이어도 ssufree 로 돌려준 구간이면 안 됨
+    return -1;
   *pp = (char*)i;
   return 0;
 }
@@ -106,6 +111,11 @@ extern int sys_uptime(void);
 extern int sys_getvp(void);
 extern int sys_getpp(void);
 extern int sys_ssualloc(void);
+extern int sys_faultaround(void);
+extern int sys_memstat(void);
+extern int sys_ssufree(void);
+extern int sys_mmap(void);
+extern int sys_superpage(void);
 
 
 static int (*syscalls[])(void) = {
@@ -133,6 +143,11 @@ static int (*syscalls[])(void) = {
 [SYS_getvp]   sys_getvp,
 [SYS_getpp]   sys_getpp,
 [SYS_ssualloc] sys_ssualloc,
+[SYS_faultaround] sys_faultaround,
+[SYS_memstat] sys_memstat,
+[SYS_ssufree] sys_ssufree,
+[SYS_mmap]    sys_mmap,
+[SYS_superpage] sys_superpage,
 };
 
 void
@@ -23,3 +23,8 @@
 #define SYS_getvp  22
 #define SYS_getpp  23
 #define SYS_ssualloc  24
+#define SYS_faultaround 25
+#define SYS_memstat 26
+#define SYS_ssufree 27
+#define SYS_mmap   28
+#define SYS_superpage 29
@@ -8,6 +8,7 @@
 #include "defs.h"
 #include "param.h"
 #include "stat.h"
+#include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
 #include "fs.h"
@@ -216,8 +217,11 @@ sys_unlink(void)
   }
 
   memset(&de, 0, sizeof(de));
+  if(dp->minor > 0)   //해시 디렉토리는 지운 자리에 이름을 남김 (fs.h 참고)
+    strncpy(de.name, name, DIRSIZ);
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcache_enter(dp, name, 0, 0);  //이제 없는 이름
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -229,6 +233,7 @@ sys_unlink(void)
   iunlockput(ip);
 
   end_op();
+  ireap();    //큰 파일은 자기 트랜잭션들로 해제
 
   return 0;
 
@@ -261,14 +266,19 @@ create(char *path, short type, short major, short minor)
     panic("create: ialloc");
 
   ilock(ip);
-  ip->major = major;
-  ip->minor = minor;
+  if(type == T_DEV){ //장치파일이 아니면 major 에는 ialloc 이 정한 블록 매핑 방식이 들어있음
+    ip->major = major;
+    ip->minor = minor;
+  }
   ip->nlink = 1;
   iupdate(ip);
 
   if(type == T_DIR){  // Create . and .. entries.
     dp->nlink++;  // for ".."
     iupdate(dp);
+#ifdef HASHDIR
+    hdirinit(ip);  // P4 : 버킷 하나짜리 해시 디렉토리로 시작해서 엔트리가 늘면 버킷이 늘어남 (fs.c hdirsplit)
+#endif
     // No ip->nlink++ for ".": avoid cyclic ref count.
     if(dirlink(ip, ".", ip->inum) < 0 || dirlink(ip, "..", dp->inum) < 0)
       panic("create dots");
@@ -313,6 +323,12 @@ sys_open(void)
       return -1;
     }
   }
+  //실행 중인 프로그램 파일은 쓰기용으로 열 수 없음 (file.h ntext)
+  if((omode & (O_WRONLY|O_RDWR)) && ip->ntext > 0){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
 
   if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
     if(f)
@@ -389,6 +405,7 @@ sys_chdir(void)
   iunlock(ip);
   iput(curproc->cwd);
   end_op();
+  ireap();
   curproc->cwd = ip;
   return 0;
 }
@@ -422,7 +439,7 @@ sys_exec(void)
 int
 sys_pipe(void)
 {
-  int *fd;
+  int *fd, fds[2];
   struct file *rf, *wf;
   int fd0, fd1;
 
@@ -438,8 +455,50 @@ sys_pipe(void)
     fileclose(wf);
     return -1;
   }
-  fd[0] = fd0;
-  fd[1] = fd1;
+  fds[0] = fd0;
+  fds[1] = fd1;
+  //P4 : fd 에 직접 쓰지 않음 (읽기 전용 mmap 구간이면 커널 폴트 대신 -1, vm.c copyoutuser)
+  if(copyoutuser((uint)fd, fds, sizeof(fds)) < 0){
+    myproc()->ofile[fd0] = 0;
+    myproc()->ofile[fd1] = 0;
+    fileclose(rf);
+    fileclose(wf);
+    return -1;
+  }
   return 0;
 }
 
+
+// P4 : 파일 fd 의 off 부터 len 바이트를 프로세스 주소 공간 끝(sz)에 매핑하고 시작 주소를 돌려줌
+// 페이지는 처음 접근할 때 trap.c 에서 readi 로 채움 (vm.c vmaread)
+// MAP_SHARED|MAP_WRITE 면 수정된 페이지를 ssufree/exit/exec 때 파일에 씀 (vm.c vmaflush)
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int off, len, flags;
+  uint start, end;
+  struct proc *curproc = myproc();
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &len) < 0 || argint(3, &flags) < 0)
+    return -1;
+  if(f->type != FD_INODE || !f->readable || off < 0 || off % PGSIZE != 0 || len <= 0)
+    return -1;
+  if((flags & MAP_WRITE) && (flags & MAP_SHARED) && !f->writable)
+    return -1;
+  start = PGROUNDUP(curproc->sz);
+  end = start + PGROUNDUP(len);
+  if(end >= KERNBASE || end < start)
+    return -1;
+  filedup(f);  //구간이 파일 참조를 하나 들고 있음 (fd 를 닫아도 매핑은 유지)
+  if(vmaadd(curproc, start, end, f, off, flags & (MAP_WRITE|MAP_SHARED)) < 0){
+    fileclose(f);
+    return -1;
+  }
+  if(lazyuvm(curproc->pgdir, start, end) < 0){
+    vmaremove(curproc, start, end);  //구간이 들고 있던 참조도 fileclose 로 놓음
+    return -1;
+  }
+  curproc->sz = end;
+  return start;
+}
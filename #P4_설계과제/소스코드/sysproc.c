@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "memstat.h"
 
 int
 sys_fork(void)
@@ -93,6 +94,10 @@ sys_uptime(void)
 int
 sys_getpp()
 {
+#ifndef ORIGIN
+  //P4 : 할당/해제/페이지 폴트 때 갱신하는 카운터 (proc.h) 를 바로 돌려줌
+  return myproc()->rss;
+#else //매번 사용자 영역 페이지 테이블 전체를 훑는 이전 방식
   //memlayout.h 에서 사용자 영역 확인.
   pde_t *pgdir = myproc()->pgdir, pde;
   pde_t *pgtab;
@@ -103,16 +108,20 @@ sys_getpp()
   int pde_point = PDX(KERNBASE), pte_point = 0x400, i,j;
   int retVal = 0;
   for (i = 0 ; i < pde_point ; i++) { 
-    if ((pde = pgdir[i]) & PTE_P) { //Page Directory가 할당되어있는지 확인
+    if ((pde = pgdir[i]) & PTE_PS) { //4MB superpage 는 물리페이지 NPTENTRIES 개
+      retVal += NPTENTRIES;
+    } else if (pde & PTE_P) { //Page Directory가 할당되어있는지 확인
       pgtab = (pte_t*)P2V(PTE_ADDR(pde)); //Page Table 할당
       for (j = 0 ; j < pte_point ; j++) {
-        if (pgtab[j] & PTE_P) {  //PTE가 할당되어있으면 페이지개수 증가
+        //PTE가 할당되어있으면 페이지개수 증가 (읽기만 한 lazy 페이지가 공유하는 zero page 는 제외)
+        if ((pgtab[j] & PTE_P) && PTE_ADDR(pgtab[j]) != V2P(zeropage)) {
           retVal++;
         }
       }
     } 
   }
   return retVal; //물리페이지 개수 리턴
+#endif
 }
 
 /**
@@ -143,7 +152,10 @@ sys_ssualloc()
   int pde_point = 1<<9, pte_point = 1<<10, i,j ,serial_count = 0;
   int save_i=-1, save_j=-1;
   for (i = 0 ; i < pde_point ; i++) {
-    if ((pde = pgdir[i]) & (PTE_P)) {
+    if ((pde = pgdir[i]) & PTE_PS) { //superpage 는 빈 곳이 없음
+      serial_count = 0;
+      save_i = save_j = -1;
+    } else if (pde & (PTE_P)) {
       pgtab = (pte_t*)P2V(PTE_ADDR(pde)); //Page Table 할당
       for (j = 0 ; j < pte_point ; j++) {
           //LAZE 배치 뿐 아니라 P 비트가 할당안되면서 연속적인 공간을 찾아야함
@@ -181,12 +193,16 @@ sys_ssualloc()
   }
 
   //이제saved_i,j 에 가상페이지를 배치해보자
+  if (vmaadd(myproc(), PGADDR(save_i, save_j, 0), PGADDR(save_i, save_j, 0) + size, 0, 0, 0) < 0)
+    return -1;
   pde = pgdir[save_i];
   pgtab = (pte_t*)P2V(PTE_ADDR(pde));
   for (j = save_j, i = save_i ; j < save_j + blockCount ; j++) {
     pgtab[j] = PTE_LAZY; //pteLazy하나 박아줌
   }
   myproc()->sz += size;
+  myproc()->vpages += blockCount;
+  myproc()->nlazy += blockCount;
   return PGADDR(save_i, save_j, 0);
 
   //배치가 결정된 공간에 PTE_LAZY 설정하도록 하자
@@ -198,12 +214,17 @@ sys_ssualloc()
     return 0;
   uint allocAddr = PGROUNDUP(sz); //현재 sz위치에 페이지 할당 (새롭게 할당)
   uint returnAddress = allocAddr; //return 할 주소
+  //예약 구간 기록 (trap.c 는 이 구간 안의 폴트만 lazy 할당으로 처리)
+  if (size > 0 && vmaadd(myproc(), returnAddress, PGROUNDUP(sz + size), 0, 0, 0) < 0)
+    return -1;
   for (; allocAddr < sz + size ; allocAddr += PGSIZE)  { //allocuvm 참고
     pde = pgdir[PDX(allocAddr)]; //가상 페이지 확인
     //vm.c : walkpgdir 참고
     if (!(pde & PTE_P)) { //페이지 디렉토리 없으면 할당해야지?
-      if((pgtab = (pde_t*)kalloc()) <0) { //페이지가 할당되지 않으면 에러처리
+      if((pgtab = (pde_t*)kalloc()) == 0) { //페이지가 할당되지 않으면 에러처리
         cprintf("I want to Allocate PDE. But, the system didn't help me.. bye\n");
+        deallocuvm(pgdir, allocAddr, returnAddress); //지금까지 박아넣은 PTE_LAZY 와 구간을 되돌림
+        vmaremove(myproc(), returnAddress, PGROUNDUP(sz + size));
         return -1;
       }
       memset(pgtab, 0, PGSIZE);
@@ -216,6 +237,8 @@ sys_ssualloc()
     pgtab = (pte_t*)P2V(PTE_ADDR(pde)); //페이지 테이블 받아오기 (해당 PDE의)
     pgtab[PTX(allocAddr)] = PTE_LAZY; //나중에 물리메모리를 할당하겠다는 플래그를 박아넣음 
     //(진짜 페이지폴트인지 Lazy Allocation 인지 확인용)
+    myproc()->vpages++;
+    myproc()->nlazy++;
   }
   myproc()->sz = sz + size; //프로세스 사이즈 재갱신
   return returnAddress;
@@ -226,6 +249,10 @@ sys_ssualloc()
 int
 sys_getvp()
 {
+#ifndef ORIGIN
+  //P4 : 할당/해제/페이지 폴트 때 갱신하는 카운터 (proc.h) 를 바로 돌려줌
+  return myproc()->vpages;
+#else //매번 사용자 영역 페이지 테이블 전체를 훑는 이전 방식
   //memlayout.h 에서 사용자 영역 확인.
   pde_t *pgdir = myproc()->pgdir, pde;
   pde_t *pgtab;
@@ -233,7 +260,9 @@ sys_getvp()
   int pde_point = PDX(KERNBASE), pte_point = 0x400, i,j; 
   int retVal = 0;
   for (i = 0 ; i < pde_point ; i++) {
-    if ((pde = pgdir[i]) & PTE_P) { //페이지 디렉토리가 할당되어있는지 확인
+    if ((pde = pgdir[i]) & PTE_PS) { //4MB superpage 는 가상페이지 NPTENTRIES 개
+      retVal += NPTENTRIES;
+    } else if (pde & PTE_P) { //페이지 디렉토리가 할당되어있는지 확인
       pgtab = (pte_t*)P2V(PTE_ADDR(pde)); //PDE에 할당된 Page Table 개수 확인
       for (j = 0 ; j < pte_point ; j++) {
         //PTE_P 뿐 아니라 PTE_LAZY (Lazy Allocation) 둘 다 가상메모리페이지 개수로 사용할 수 있음
@@ -245,4 +274,102 @@ sys_getvp()
   }
   return retVal; //가상 페이지 개수 리턴
   //프로세스 페이지테이블의 할당된 물리페이지 수를 의미하는듯
-}
\ No newline at end of file
+#endif
+}
+/**
+ * lazy 페이지 폴트 때 주변 PTE_LAZY 페이지를 미리 채울 최대 창 크기 설정 (trap.c 참고)
+ * @param npages : 1 ~ FAULTAROUND (1 이면 fault-around 끔), 0 이면 설정은 그대로 두고 조회만
+ * @return 지금까지 처리한 lazy 페이지 폴트 횟수, 잘못된 인자면 -1
+*/
+int
+sys_faultaround(void)
+{
+  int npages;
+  struct proc *curproc = myproc();
+
+  if (argint(0, &npages) < 0 || npages < 0 || npages > FAULTAROUND)
+    return -1;
+  if (npages > 0) {
+    curproc->fa_max = npages;
+    curproc->fa_win = 1;
+  }
+  return curproc->nfault;
+}
+
+/**
+ * 4MB 구간 전체가 예약된 익명 구간의 쓰기 폴트를 superpage 로 매핑할지 설정 (기본은 끔, trap.c, vm.c superuvm)
+ * superpage 는 스왑으로 내보내지 않고 fork 때마다 4KB 페이지로 쪼개지므로
+ * 큰 익명 메모리를 오래 쓰는 프로세스만 켜서 쓰도록 함 (fork 한 자식은 설정을 물려받음)
+ * @param enable : 1 이면 켬, 0 이면 끔, -1 이면 설정은 그대로 두고 조회만
+ * @return 이전 설정 (켜져 있었으면 1, 꺼져 있었으면 0), 잘못된 인자면 -1
+*/
+int
+sys_superpage(void)
+{
+  int enable, old;
+  struct proc *curproc = myproc();
+
+  if (argint(0, &enable) < 0 || enable < -1 || enable > 1)
+    return -1;
+  old = curproc->superok;
+  if (enable >= 0)
+    curproc->superok = enable;
+  return old;
+}
+
+/**
+ * 현재 프로세스의 메모리 사용량을 한 번에 돌려줌 (페이지 테이블을 훑지 않음)
+ * @param ms : struct memstat (memstat.h) 를 채울 사용자 주소
+ * @return 성공 0, 잘못된 주소면 -1
+*/
+int
+sys_memstat(void)
+{
+  struct memstat *ms, s;
+  struct proc *curproc = myproc();
+
+  if (argptr(0, (void*)&ms, sizeof(*ms)) < 0)
+    return -1;
+  s.vpages = curproc->vpages;
+  s.rss = curproc->rss;
+  s.lazy = curproc->nlazy;
+  s.faults = curproc->nfault;
+  s.swapped = curproc->nswap;
+  return copyoutuser((uint)ms, &s, sizeof(s));  //읽기 전용 mmap 구간이면 커널 폴트 대신 -1
+}
+
+/**
+ * ssualloc/mmap 으로 예약한 구간 [addr, addr+size) 를 돌려줌 (구간 일부만 돌려주면 구멍이 뚫림)
+ * 물리 페이지가 할당된 페이지는 kfree, 아직 접근하지 않은 페이지는 PTE_LAZY 만 지움
+ * MAP_SHARED|MAP_WRITE 로 mmap 한 페이지는 수정된 내용을 먼저 파일에 씀 (munmap)
+ * 프로세스 크기(sz)는 그대로이고, 돌려준 주소에 접근하면 프로세스가 죽음
+ * @param addr : 페이지 경계 주소
+ * @param size : 페이지 크기의 배수
+ * @return 성공 0, 예약하지 않은 주소가 섞여 있거나 구간 목록이 가득 차면 -1
+*/
+int
+sys_ssufree(void)
+{
+  int addr, size;
+  uint a, end;
+  struct vma *v;
+  struct proc *curproc = myproc();
+
+  if (argint(0, &addr) < 0 || argint(1, &size) < 0)
+    return -1;
+  if (addr % PGSIZE != 0 || size <= 0 || size % PGSIZE != 0)
+    return -1;
+  end = (uint)addr + size;
+  if (end < (uint)addr || end > curproc->sz)
+    return -1;
+  //전부 예약된 구간 안인지 확인 (맞닿은 구간은 합쳐져 있으므로 구간 끝에서 끊기면 실패)
+  for (a = addr; a < end; a = v->end)
+    if ((v = vmalookup(curproc, a)) == 0)
+      return -1;
+  vmaflush(curproc, addr, end);
+  if (vmaremove(curproc, addr, end) < 0)
+    return -1;
+  deallocuvm(curproc->pgdir, end, addr); //카운터 (memstat) 도 여기서 갱신됨
+  lcr3(V2P(curproc->pgdir)); //지운 페이지의 TLB 항목 제거
+  return 0;
+}
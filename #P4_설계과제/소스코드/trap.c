@@ -7,6 +7,10 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
 //int mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
 
 // Interrupt descriptor table (shared by all CPUs).
@@ -14,7 +18,6 @@ struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
-uint va;
 
 void
 tvinit(void)
@@ -34,13 +37,113 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
-//PAGEBREAK: 41
-void
-trap(struct trapframe *tf)
+// P4 : 사용자 주소 va 의 페이지 폴트 처리 (lazy 할당, mmap/exec 파일 읽기, 스왑 인, copy-on-write)
+// err 는 폴트 에러코드 (FEC_WR), cansleep 이 0 이면 커널이 spinlock 을 잡은 채 난 폴트라 잠드는 경로는 쓰지 않음
+// 처리했으면 0, 잘못된 접근이거나 지금은 처리할 수 없으면 -1
+// trap 과 vm.c pinuvm (lock 을 잡기 전에 사용자 버퍼를 미리 채움) 에서 부름
+int
+pagefault(uint va, uint err, int cansleep)
 {
   char* pa;
   pde_t* pdir, pde;
   pte_t* pgtab, pte;
+
+  pdir = myproc()->pgdir;
+  va = PGROUNDDOWN(va); //가상주소 변경
+  pde = pdir[PDX(va)];
+  pgtab = (pte_t*)P2V(PTE_ADDR(pde));
+  pte = (pde & (PTE_P|PTE_PS)) == PTE_P ? pgtab[PTX(va)] : 0; //페이지 테이블이 없으면 (superpage 포함) 진짜 잘못된 접근
+  //스왑 영역으로 나간 페이지 : 다시 읽어옴 (swap.c), 디스크를 읽으므로 잠들 수 있을 때만
+  if (!(pte & PTE_P) && (pte & PTE_SWAP)) {
+    if (!cansleep || swapin(&pgtab[PTX(va)], va) < 0)
+      return -1;
+    return 0;
+  }
+  if (pte & PTE_LAZY) {
+    struct proc *p = myproc();
+    struct vma *v;
+    uint a, n;
+    int fileok;
+    //PTE 비트만 믿지 않고 ssualloc/mmap 으로 예약한 구간 안의 주소인지 확인
+    if ((v = vmalookup(p, va)) == 0)
+      return -1;
+    if (v->f && (err & FEC_WR) && !(v->flags & MAP_WRITE)) //읽기 전용 mmap 에 쓰기
+      return -1;
+    p->nfault++;
+    //superpage : 4MB 구간 전체가 예약된 익명 구간의 쓰기 폴트는 4MB 를 한 번에 매핑 (vm.c superuvm, superpage(1) 로 켠 프로세스만)
+    //4MB 구간이 맞지 않거나 연속된 물리 페이지가 없으면 아래 4KB 경로로 처리
+    if (p->superok && (err & FEC_WR) && superuvm(pdir, v, va) == 0)
+      return 0;
+    //파일에서 읽어야 하는 페이지 (vmaread) 는 ilock + bread 로 잠듦
+    //spinlock 을 잡았거나 이 파일의 inode lock 을 이미 잡은 채 (readi/writei 가 같은 파일의 mmap 버퍼를 건드림) 난 폴트면 읽지 않음
+    //-> 보통은 file.c 가 lock 을 잡기 전에 pinuvm 으로 미리 채워 두므로 여기까지 오지 않음
+    fileok = v->f == 0 || (cansleep && !holdingsleep(&v->f->ip->lock));
+    //fault-around : 직전 폴트가 채운 구간 바로 다음이면 순차 접근으로 보고 창을 두 배로 (fa_max 까지)
+    if (va == p->fa_next)
+      p->fa_win = (p->fa_win * 2 < p->fa_max) ? p->fa_win * 2 : p->fa_max;
+    else
+      p->fa_win = 1;
+    //폴트난 페이지부터 같은 구간, 같은 페이지 테이블 안의 연속된 PTE_LAZY 페이지를 창 크기만큼 채움
+    for (a = va, n = 0; n < p->fa_win && a < v->end && PDX(a) == PDX(va); a += PGSIZE, n++) {
+      if (!(pgtab[PTX(a)] & PTE_LAZY))
+        break;
+      if (!(err & FEC_WR) && v->f == 0) {
+        //읽기 폴트 : 공유 zero page 를 읽기 전용으로 매핑 -> 처음 쓸 때 아래 copy-on-write 경로에서 새 페이지 할당
+        pgtab[PTX(a)] = V2P(zeropage) | PTE_P | PTE_U | PTE_COW;
+        p->nlazy--;
+        continue;
+      }
+      if (!fileok && a - v->start < v->filesz) {
+        if (n == 0)
+          return -1;
+        break;
+      }
+      //물리 메모리 할당 : 폴트난 페이지는 모자라면 다른 페이지를 스왑으로 내보내서라도 할당
+      //잠들 수 없으면 (piperead 등이 spinlock 을 잡은 채 sbrk 힙 버퍼를 건드림) kalloc 만
+      if ((pa = (n == 0 && cansleep) ? swapalloc(va) : kalloc()) == 0) {
+        if (n == 0)
+          return -1;
+        break; //주변 페이지는 못 채워도 괜찮음
+      }
+      memset((void*)pa, 0, (uint)PGSIZE); 
+      if (v->f == 0) {
+        //해당 가상메모리를 V2P(커널영역->사용장여역) 으로 할당하고 PTE_W, PTE_U 플래그 설정 (present 가 아니었으므로 TLB flush 불필요)
+        pgtab[PTX(a)] = V2P(pa) | PTE_P | PTE_W | PTE_U;
+      } else {
+        //mmap 구간 : 파일 내용을 readi 로 채우고, MAP_WRITE 일 때만 쓰기 허용
+        vmaread(v, pa, a);
+        pgtab[PTX(a)] = V2P(pa) | PTE_P | PTE_U | ((v->flags & MAP_WRITE) ? PTE_W : 0) | ((v->flags & MAP_SHARED) ? PTE_SHR : 0);
+      }
+      p->nlazy--;
+      p->rss++;
+    }
+    p->fa_next = a;
+    return 0;
+  }
+  //copy-on-write : fork 후 공유 중인 페이지에 처음 쓸 때 복사 (vm.c copyuvm 참고)
+  if ((pte & (PTE_P|PTE_COW)) == (PTE_P|PTE_COW) && (err & FEC_WR)) {
+    pa = P2V(PTE_ADDR(pte));
+    if (pa == zeropage || krefcnt(pa) > 1) { //zero page 거나 아직 다른 프로세스도 쓰는 중이면 내 것만 새로 복사
+      char *mem = cansleep ? swapalloc(va) : kalloc(); //swapout 은 bwrite 로 잠듦
+      if (mem == 0)
+        return -1;
+      memmove(mem, pa, PGSIZE);
+      if (pa == zeropage) //읽기만 하던 lazy 페이지에 처음 씀
+        myproc()->rss++;
+      kfree(pa); //공유 페이지의 참조 횟수만 줄어듦
+      pa = mem;
+    }
+    pgtab[PTX(va)] = V2P(pa) | ((PTE_FLAGS(pte) | PTE_W) & ~PTE_COW);
+    lcr3(V2P(pdir)); //읽기 전용이던 TLB 항목 제거
+    return 0;
+  }
+  return -1;
+}
+
+//PAGEBREAK: 41
+void
+trap(struct trapframe *tf)
+{
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
@@ -83,20 +186,9 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
   case T_PGFLT:
-    pdir = myproc()->pgdir;
-    va = rcr2();  //페이지폴트 예외에서의 가상주소를 읽어오는 명령어로 추정
-    va = PGROUNDDOWN(va); //가상주소 변경
-    //cprintf("Page Fault : %d\n", va); //확인해보니까 맞음
-    pde = pdir[PDX(va)];
-    pgtab = (pte_t*)P2V(PTE_ADDR(pde));
-    pte = pgtab[PTX(va)];
-    if (pte & PTE_LAZY) {
-      pa = kalloc(); //물리 메모리 할당 
-      memset((void*)pa, 0, (uint)PGSIZE); 
-      //해당 가상메모리를 PGSIZE (4096) 만큼 V2P(커널영역->사용장여역) 으로 할당하고 PTE_W, PTE_U 플래그 설정
-      mappages(myproc()->pgdir, (char*)va, PGSIZE, V2P(pa), PTE_W|PTE_U);
+    //커널이 spinlock 을 잡은 채 난 폴트 (ncli > 0) 면 잠드는 경로 (스왑, 파일 읽기) 는 쓰지 않음
+    if(myproc() && pagefault(rcr2(), tf->err, mycpu()->ncli == 0) == 0)
       break;
-    }
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -122,8 +214,11 @@ trap(struct trapframe *tf)
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER){
+    myproc()->upreempt = (tf->cs&3) == DPL_USER;  // P4 : 사용자 모드에서 멈춘 동안만 페이지를 쫓아낼 수 있음 (proc.c pageout)
     yield();
+    myproc()->upreempt = 0;
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
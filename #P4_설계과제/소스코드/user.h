@@ -1,5 +1,6 @@
 struct stat;
 struct rtcdate;
+struct memstat;
 
 // system calls
 int fork(void);
@@ -28,6 +29,11 @@ int uptime(void);
 int getvp();
 int getpp();
 int ssualloc(int);
+int faultaround(int);
+int memstat(struct memstat*);
+int ssufree(void*, int);
+void* mmap(int, int, int, int);
+int superpage(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -6,6 +6,11 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -44,6 +49,8 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 
   // PDX : PDE 를 구하는 과정 (22비트 땡기는걸로보아 상위 10비트가 PDE임)
   pde = &pgdir[PDX(va)];
+  if(*pde & PTE_PS)
+    panic("walkpgdir: superpage");  // P4 : 4MB superpage 는 페이지 테이블이 없음 (splitpde 로 먼저 쪼개야 함)
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
     //cprintf("pgtab : %0x\n", pgtab);
@@ -226,6 +233,20 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
   return 0;
 }
 
+// P4 : pgdir 이 현재 프로세스의 페이지 테이블이면 메모리 카운터 (proc.h) 갱신
+// exec 가 만드는 중인 pgdir 이나 wait 에서 해제하는 자식 pgdir 은 건너뜀 (exec/allocproc 에서 다시 설정)
+static void
+memacct(pde_t *pgdir, int vpages, int rss, int lazy)
+{
+  struct proc *p = myproc();
+
+  if(p == 0 || p->pgdir != pgdir)
+    return;
+  p->vpages += vpages;
+  p->rss += rss;
+  p->nlazy += lazy;
+}
+
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
 int
@@ -254,10 +275,23 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       kfree(mem);
       return 0;
     }
+    memacct(pgdir, 1, 1, 0);
   }
   return newsz;
 }
 
+// P4 : superpage PDE 를 같은 물리 페이지들을 차례로 가리키는 4KB PTE 의 페이지 테이블 pgtab 으로 쪼갬
+// 가리키는 주소는 그대로이므로 TLB 는 호출한 쪽이 나중에 flush 해도 됨
+static void
+splitpde(pde_t *pde, pte_t *pgtab)
+{
+  uint pa = PTE_ADDR(*pde), flags = PTE_FLAGS(*pde) & ~PTE_PS, i;
+
+  for(i = 0; i < NPTENTRIES; i++)
+    pgtab[i] = (pa + i*PGSIZE) | flags;
+  *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -265,14 +299,40 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
+  pde_t *pde;
   pte_t *pte;
-  uint a, pa;
+  uint a, pa, i;
+  char *mem;
 
   if(newsz >= oldsz)
     return oldsz;
 
   a = PGROUNDUP(newsz);
   for(; a  < oldsz; a += PGSIZE){
+    pde = &pgdir[PDX(a)];
+    if(*pde & PTE_PS){
+      if(PTX(a) == 0 && a + SPGSIZE <= oldsz){
+        //4MB superpage 를 통째로 해제 (물리 페이지는 4KB 씩 freelist 로 돌아감)
+        pa = PTE_ADDR(*pde);
+        for(i = 0; i < NPTENTRIES; i++)
+          kfree(P2V(pa + i*PGSIZE));
+        memacct(pgdir, -NPTENTRIES, -NPTENTRIES, 0);
+        *pde = 0;
+        a += SPGSIZE - PGSIZE;
+        continue;
+      }
+      //일부만 해제 (ssufree, sbrk 축소) : 4KB 페이지로 쪼갠 뒤 아래에서 페이지 단위로 해제
+      //페이지 테이블로 쓸 페이지가 없으면 지금 해제할 a 페이지를 페이지 테이블로 씀
+      if((mem = kalloc()) != 0)
+        splitpde(pde, (pte_t*)mem);
+      else {
+        mem = P2V(PTE_ADDR(*pde) + PTX(a)*PGSIZE);
+        splitpde(pde, (pte_t*)mem);
+        ((pte_t*)mem)[PTX(a)] = 0;
+        memacct(pgdir, -1, -1, 0);
+        continue;
+      }
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
@@ -281,8 +341,20 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       if(pa == 0)
         panic("kfree");
       char *v = P2V(pa);
+      memacct(pgdir, -1, v == zeropage ? 0 : -1, 0);
       kfree(v);
       *pte = 0;
+    } else if(*pte & PTE_LAZY){
+      //아직 폴트가 나지 않은 ssualloc 페이지는 예약만 지움
+      memacct(pgdir, -1, 0, -1);
+      *pte = 0;
+    } else if(*pte & PTE_SWAP){
+      //스왑 영역으로 나간 페이지는 슬롯만 놓음
+      swapfree(*pte);
+      memacct(pgdir, -1, 0, 0);
+      if(myproc() && myproc()->pgdir == pgdir)
+        myproc()->nswap--;
+      *pte = 0;
     }
   }
   return newsz;
@@ -322,34 +394,57 @@ clearpteu(pde_t *pgdir, char *uva)
 
 // Given a parent process's page table, create a copy
 // of it for a child.
+// P4 : copy-on-write. 물리 페이지를 복사하지 않고 부모와 자식이 같은 페이지를 공유
+// 쓰기 가능한 페이지는 양쪽 모두 읽기 전용 + PTE_COW 로 바꾸고
+// 처음 쓰는 쪽이 trap.c 의 페이지 폴트에서 복사함 (kalloc.c 의 참조 횟수 참고)
+// 아직 접근하지 않은 PTE_LAZY 페이지는 자식에게도 예약(PTE_LAZY)으로만 넘겨줌
+// -> 물리 페이지가 있는 페이지 수에 비례하는 시간만 걸림
+// fork 에서만 불리므로 pgdir 은 현재 프로세스의 페이지 테이블
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
+  pte_t *pte, *cpte;
   uint pa, i, flags;
   char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+    //superpage 는 4KB 페이지로 쪼갠 뒤 페이지 단위로 공유 (쓰기 폴트마다 4MB 를 복사하지 않도록)
+    if(pgdir[PDX(i)] & PTE_PS){
+      if((mem = kalloc()) == 0)
+        goto bad;
+      splitpde(&pgdir[PDX(i)], (pte_t*)mem);
+    }
+    //ssufree 로 돌려준 구멍은 페이지 테이블이나 PTE 가 없을 수 있음
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(!(*pte & PTE_P)){
+      if(!(*pte & (PTE_LAZY|PTE_SWAP)))
+        continue;
+      if((cpte = walkpgdir(d, (void *) i, 1)) == 0)
+        goto bad;
+      if(*pte & PTE_SWAP)  //스왑 슬롯은 자식과 같이 가리킴 (각자 읽어올 때 자기 복사본을 가짐)
+        swapdup(*pte);
+      *cpte = *pte;
+      continue;
+    }
+    if((*pte & PTE_W) && !(*pte & PTE_SHR))  //MAP_SHARED 페이지는 부모/자식이 그대로 같이 씀
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
       goto bad;
-    }
+    kincref(P2V(pa));
   }
+  lcr3(V2P(pgdir));  //부모 TLB 에 남아있는 쓰기 가능 항목 제거
   return d;
 
 bad:
+  lcr3(V2P(pgdir));
   freevm(d);
   return 0;
 }
@@ -395,6 +490,397 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   return 0;
 }
 
+// P4 : ssualloc/mmap 으로 예약한 구간 목록 (proc.h struct vma)
+// p->vma[0 ~ nvma-1] 은 start 오름차순이고 서로 겹치지 않으며, 맞닿은 ssualloc 구간은 하나로 합침
+// mmap 구간은 파일 참조 (filedup) 를 하나씩 들고 있고 구간이 없어질 때 fileclose
+
+// va 를 포함하는 구간 (없으면 0), 정렬되어 있으므로 이진 탐색
+struct vma*
+vmalookup(struct proc *p, uint va)
+{
+  int lo = 0, hi = p->nvma - 1, mid;
+
+  while(lo <= hi){
+    mid = (lo + hi) / 2;
+    if(va < p->vma[mid].start)
+      hi = mid - 1;
+    else if(va >= p->vma[mid].end)
+      lo = mid + 1;
+    else
+      return &p->vma[mid];
+  }
+  return 0;
+}
+
+// [start, end) 구간 추가 (이미 있는 구간과 겹치면 안 됨), 목록이 가득 차면 -1
+// f 가 0 이 아니면 off 부터 매핑하는 mmap 구간이고, 호출한 쪽에서 얻은 파일 참조를 구간이 가져감
+int
+vmaadd(struct proc *p, uint start, uint end, struct file *f, uint off, int flags)
+{
+  int i;
+
+  for(i = 0; i < p->nvma && p->vma[i].start < start; i++)
+    ;
+  if(f == 0 && i > 0 && p->vma[i-1].f == 0 && p->vma[i-1].end == start){  //앞 구간에 이어붙임
+    p->vma[i-1].end = end;
+    if(i < p->nvma && p->vma[i].f == 0 && p->vma[i].start == end){  //뒤 구간까지 이어지면 하나로 합침
+      p->vma[i-1].end = p->vma[i].end;
+      memmove(&p->vma[i], &p->vma[i+1], (p->nvma - i - 1) * sizeof(struct vma));
+      p->nvma--;
+    }
+    return 0;
+  }
+  if(f == 0 && i < p->nvma && p->vma[i].f == 0 && p->vma[i].start == end){  //뒤 구간 앞에 이어붙임
+    p->vma[i].start = start;
+    return 0;
+  }
+  if(p->nvma == NVMA)
+    return -1;
+  memmove(&p->vma[i+1], &p->vma[i], (p->nvma - i) * sizeof(struct vma));
+  p->vma[i].start = start;
+  p->vma[i].end = end;
+  p->vma[i].f = f;
+  p->vma[i].off = off;
+  p->vma[i].filesz = end - start;
+  p->vma[i].flags = flags;
+  p->nvma++;
+  return 0;
+}
+
+// 파일 구간의 앞 n 바이트가 잘렸을 때 파일 위치를 맞춤
+static void
+vmaskip(struct vma *v, uint n)
+{
+  v->off += n;
+  v->filesz = v->filesz > n ? v->filesz - n : 0;
+}
+
+// [start, end) 와 겹치는 부분을 목록에서 지움 (구간 가운데를 지우면 둘로 나뉨)
+// 나뉠 자리가 없으면 아무것도 바꾸지 않고 -1
+int
+vmaremove(struct proc *p, uint start, uint end)
+{
+  int i;
+  struct vma *v;
+
+  for(i = 0; i < p->nvma; i++){
+    v = &p->vma[i];
+    if(v->start < start && v->end > end){  //구멍 뚫기 : [v->start, start) + [end, v->end)
+      if(p->nvma == NVMA)
+        return -1;
+      memmove(&p->vma[i+1], &p->vma[i], (p->nvma - i) * sizeof(struct vma));
+      p->nvma++;
+      p->vma[i].end = start;
+      p->vma[i+1].start = end;
+      if(v->f){  //뒤쪽 조각도 같은 파일을 참조
+        filedup(v->f);
+        vmaskip(&p->vma[i+1], end - v->start);
+      }
+      return 0;
+    }
+  }
+  for(i = 0; i < p->nvma; ){
+    v = &p->vma[i];
+    if(v->end <= start || v->start >= end){  //겹치지 않음
+      i++;
+      continue;
+    }
+    if(v->start >= start && v->end <= end){  //통째로 지움
+      if(v->f)
+        fileclose(v->f);
+      memmove(&p->vma[i], &p->vma[i+1], (p->nvma - i - 1) * sizeof(struct vma));
+      p->nvma--;
+      continue;
+    }
+    if(v->start < start)  //뒤쪽이 잘림
+      v->end = start;
+    else{                 //앞쪽이 잘림
+      vmaskip(v, end - v->start);
+      v->start = end;
+    }
+    i++;
+  }
+  return 0;
+}
+
+// [start, end) 를 PTE_LAZY 로 예약 (물리 페이지는 폴트 때 할당), 페이지 테이블을 못 만들면 -1
+int
+lazyuvm(pde_t *pgdir, uint start, uint end)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDUP(start); a < end; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 1)) == 0){
+      deallocuvm(pgdir, a, start);
+      return -1;
+    }
+    if(*pte & (PTE_P|PTE_LAZY))
+      panic("lazyuvm: remap");
+    *pte = PTE_LAZY;
+    memacct(pgdir, 1, 0, 1);
+  }
+  return 0;
+}
+
+// P4 : exec 가 lazyuvm 으로 예약한 start ~ end 페이지 (페이지 경계) 를 지금 할당하고
+// ip 의 offset 부터 sz 바이트로 채움 (그 뒤는 0, ip 는 잠겨 있어야 함)
+// 채운 페이지 수를 리턴, 실패하면 -1 (채운 페이지와 남은 예약은 exec 의 freevm 이 정리)
+int
+filluvm(pde_t *pgdir, uint start, uint end, struct inode *ip, uint offset, uint sz)
+{
+  pte_t *pte;
+  char *mem;
+  uint a, n;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_LAZY))
+      panic("filluvm");
+    if((mem = kalloc()) == 0)
+      return -1;
+    memset(mem, 0, PGSIZE);
+    n = a - start < sz ? sz - (a - start) : 0;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    if(n > 0 && readi(ip, mem, offset + (a - start), n) != n){
+      kfree(mem);
+      return -1;
+    }
+    *pte = V2P(mem) | PTE_P | PTE_W | PTE_U;
+  }
+  return (end - start) / PGSIZE;
+}
+
+// P4 : va 가 속한 4MB 구간 전체가 익명 구간 v 안이고 아직 한 페이지도 폴트나지 않았으면
+// 그 페이지 테이블을 4MB superpage (PTE_PS) PDE 하나로 바꿈 (trap.c, superpage(1) 로 켰을 때)
+// -> 페이지 테이블 페이지 하나와 TLB 항목 1023 개를 아낌
+// 조건이 맞지 않거나 연속된 물리 페이지가 없으면 -1 (호출한 쪽은 4KB 페이지로 처리)
+int
+superuvm(pde_t *pgdir, struct vma *v, uint va)
+{
+  uint base = SPGROUNDDOWN(va), i;
+  pte_t *pgtab;
+  char *mem;
+
+  if(v->f || base < v->start || base + SPGSIZE > v->end)
+    return -1;
+  if((pgdir[PDX(base)] & (PTE_P|PTE_PS)) != PTE_P)
+    return -1;
+  pgtab = (pte_t*)P2V(PTE_ADDR(pgdir[PDX(base)]));
+  for(i = 0; i < NPTENTRIES; i++)
+    if((pgtab[i] & (PTE_P|PTE_LAZY|PTE_SWAP)) != PTE_LAZY)
+      return -1;
+  if((mem = ksuperalloc()) == 0)
+    return -1;
+  memset(mem, 0, SPGSIZE);
+  pgdir[PDX(base)] = V2P(mem) | PTE_PS | PTE_P | PTE_W | PTE_U;
+  kfree((char*)pgtab);
+  memacct(pgdir, 0, NPTENTRIES, -NPTENTRIES);
+  lcr3(V2P(pgdir));  //페이지 테이블을 가리키던 PDE 를 바꿨으므로 캐시된 항목 제거
+  return 0;
+}
+
+// P4 : *va 부터 end 까지 clock (second chance) 으로 스왑 영역에 내보낼 페이지를 찾음 (proc.c pageout)
+// 최근에 접근한 페이지 (PTE_A) 는 PTE_A 만 지우고 다음 바퀴까지 기회를 줌
+// 공유 중인 페이지, zero page, MAP_SHARED 페이지, 가드 페이지, skipva, pinlo ~ pinhi (pinuvm) 는 건너뜀
+// 찾으면 그 PTE 를 돌려주고 *va 는 그 다음 페이지를 가리킴, 없으면 0
+pte_t*
+clockscan(pde_t *pgdir, uint *va, uint end, uint skipva, uint pinlo, uint pinhi)
+{
+  pte_t *pte;
+  char *pa;
+
+  for(; *va < end; *va += PGSIZE){
+    //superpage 는 스왑으로 내보내지 않음
+    if((pgdir[PDX(*va)] & PTE_PS) || (pte = walkpgdir(pgdir, (char*)*va, 0)) == 0){
+      *va = PGADDR(PDX(*va) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U) || (*pte & PTE_SHR) || *va == skipva ||
+       (*va >= pinlo && *va < pinhi))
+      continue;
+    pa = P2V(PTE_ADDR(*pte));
+    if(pa == zeropage || krefcnt(pa) > 1)
+      continue;
+    if(*pte & PTE_A){
+      *pte &= ~PTE_A;
+      continue;
+    }
+    *va += PGSIZE;
+    return pte;
+  }
+  return 0;
+}
+
+// P4 : 커널이 lock (pi->lock, cons.lock, inode lock) 을 잡은 채 addr ~ addr+n 사용자 버퍼를 건드리기 전에 부름 (file.c)
+// 잠들 수 있는 폴트 (스왑 인, mmap/exec 파일 읽기, 스왑 아웃) 를 lock 밖인 여기서 미리 처리하고
+// unpinuvm 까지 그 구간을 pageout 이 현재 프로세스에서 고르지 않게 함 (다른 프로세스는 원래 시스템 콜 중인 프로세스를 고르지 않음)
+// write 면 커널이 버퍼에 씀 -> copy-on-write 도 미리 풂, 처리할 수 없는 주소면 -1
+int
+pinuvm(char *addr, int n, int write)
+{
+  struct proc *p = myproc();
+  pde_t pde;
+  pte_t pte;
+  uint a;
+
+  if(n <= 0)
+    return 0;
+  if((uint)addr + n < (uint)addr || (uint)addr + n > KERNBASE)
+    return -1;
+  p->pinlo = PGROUNDDOWN((uint)addr);
+  p->pinhi = PGROUNDUP((uint)addr + n);
+  for(a = p->pinlo; a < p->pinhi; a += PGSIZE){
+    pde = p->pgdir[PDX(a)];
+    if(pde & PTE_PS)  //superpage 는 쓰기 가능한 익명 메모리이고 스왑으로 나가지 않음
+      continue;
+    pte = (pde & PTE_P) ? ((pte_t*)P2V(PTE_ADDR(pde)))[PTX(a)] : 0;
+    if((pte & (PTE_P|PTE_U)) == (PTE_P|PTE_U) && (!write || (pte & PTE_W)))
+      continue;
+    if(pagefault(a, write ? FEC_WR : 0, 1) < 0){
+      unpinuvm();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void
+unpinuvm(void)
+{
+  struct proc *p = myproc();
+
+  p->pinlo = p->pinhi = 0;
+}
+
+// P4 : 사용자 주소 va ~ va+n 을 커널이 건드려도 되는지 (syscall.c 의 인자 검사)
+// 매핑된 사용자 페이지와 폴트로 채울 수 있는 페이지 (예약된 구간의 PTE_LAZY, PTE_SWAP) 만 허용
+// sz 안이어도 ssufree 로 뚫린 구멍이나 가드 페이지가 섞여 있으면 -1 -> 커널 모드 폴트 (panic) 를 내지 않음
+int
+uvmcheck(uint va, uint n)
+{
+  struct proc *p = myproc();
+  pde_t pde;
+  pte_t pte;
+  uint a;
+
+  if(va + n < va || va + n > KERNBASE)
+    return -1;
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pde = p->pgdir[PDX(a)];
+    if(pde & PTE_PS)
+      continue;
+    pte = (pde & PTE_P) ? ((pte_t*)P2V(PTE_ADDR(pde)))[PTX(a)] : 0;
+    if((pte & (PTE_P|PTE_U)) == (PTE_P|PTE_U) || (pte & PTE_SWAP))
+      continue;
+    if((pte & PTE_LAZY) && vmalookup(p, a))
+      continue;
+    return -1;
+  }
+  return 0;
+}
+
+// P4 : 커널의 p 에서 len 바이트를 사용자 주소 va 에 씀 (fstat, memstat, pipe)
+// pinuvm 으로 쓰기 가능한 페이지를 먼저 확보하고 사용자 주소 대신 커널 주소 (P2V) 로 복사
+// -> 구멍이나 읽기 전용 mmap 구간이면 커널 모드 폴트 대신 -1
+int
+copyoutuser(uint va, void *p, uint len)
+{
+  pde_t *pgdir = myproc()->pgdir;
+  char *buf = (char*)p, *ka;
+  pte_t pte;
+  uint n;
+
+  if(pinuvm((char*)va, len, 1) < 0)
+    return -1;
+  while(len > 0){
+    if(pgdir[PDX(va)] & PTE_PS){
+      ka = (char*)P2V(PTE_ADDR(pgdir[PDX(va)])) + (va - SPGROUNDDOWN(va));
+      n = SPGSIZE - (va - SPGROUNDDOWN(va));
+    } else {
+      pte = ((pte_t*)P2V(PTE_ADDR(pgdir[PDX(va)])))[PTX(va)];  //pinuvm 이 채웠으므로 페이지 테이블이 있음
+      ka = (char*)P2V(PTE_ADDR(pte)) + (va - PGROUNDDOWN(va));
+      n = PGSIZE - (va - PGROUNDDOWN(va));
+    }
+    if(n > len)
+      n = len;
+    memmove(ka, buf, n);
+    len -= n;
+    buf += n;
+    va += n;
+  }
+  unpinuvm();
+  return 0;
+}
+
+// mmap/exec 구간의 va 페이지 내용을 파일에서 mem 으로 읽음 (mem 은 0 으로 채워져 있어야 함)
+// filesz 뒤나 파일 끝 뒤는 0 으로 남음
+void
+vmaread(struct vma *v, char *mem, uint va)
+{
+  struct inode *ip = v->f->ip;
+  uint n = va - v->start;
+
+  if(n >= v->filesz)
+    return;
+  n = v->filesz - n < PGSIZE ? v->filesz - n : PGSIZE;
+  ilock(ip);
+  readi(ip, mem, v->off + (va - v->start), n);  //파일 끝을 넘으면 -1 이나 짧게 읽힘 -> 나머지는 0
+  iunlock(ip);
+}
+
+// mem 에 있는 va 페이지 내용을 파일에 씀 (파일 크기는 늘리지 않음)
+// writei 는 로그 한도 때문에 짧게 쓰고 돌아올 수 있으므로 filewrite 처럼 트랜잭션을 나눠 씀
+static void
+vmawrite(struct vma *v, char *mem, uint va)
+{
+  struct inode *ip = v->f->ip;
+  uint off = v->off + (va - v->start), n, i;
+  int r;
+
+  ilock(ip);
+  n = ip->size > off ? ip->size - off : 0;
+  iunlock(ip);
+  if(n > PGSIZE)
+    n = PGSIZE;
+  for(i = 0; i < n; i += r){
+    begin_op();
+    ilock(ip);
+    r = writei(ip, mem + i, off + i, n - i);
+    iunlock(ip);
+    end_op();
+    if(r <= 0)
+      break;
+  }
+}
+
+// [start, end) 안의 MAP_SHARED|MAP_WRITE 구간에서 수정된 (PTE_D) 페이지를 파일에 씀
+// munmap(ssufree), sbrk 로 줄이기, exit, exec 에서 페이지를 지우기 전에 부름
+void
+vmaflush(struct proc *p, uint start, uint end)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a, e;
+  int flushed = 0;
+
+  for(v = p->vma; v < &p->vma[p->nvma]; v++){
+    if(v->f == 0 || (v->flags & (MAP_WRITE|MAP_SHARED)) != (MAP_WRITE|MAP_SHARED))
+      continue;
+    e = v->end < end ? v->end : end;
+    for(a = v->start > start ? v->start : PGROUNDDOWN(start); a < e; a += PGSIZE){
+      pte = walkpgdir(p->pgdir, (char*)a, 0);
+      if(pte == 0 || (*pte & (PTE_P|PTE_D)) != (PTE_P|PTE_D))
+        continue;
+      vmawrite(v, P2V(PTE_ADDR(*pte)), a);
+      *pte &= ~PTE_D;
+      flushed = 1;
+    }
+  }
+  if(flushed && p == myproc())
+    lcr3(V2P(p->pgdir));  //TLB 에 남은 dirty 항목 제거 (다시 쓰면 PTE_D 가 다시 켜지도록)
+}
+
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!